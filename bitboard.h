@@ -1,3 +1,5 @@
+#pragma once
+
 #include <stdint.h>
 #include <stdbool.h>
 
@@ -20,38 +22,77 @@ void dump_bitboard(BitBoard board, char *buffer);
 // Directional BitBoard functions below! Each function is related to sliding motion along the cardinal directions,
 // and thus each has 8 copies. Sorry.
 
+// All of these are tiny, and are called in the tightest loops of move generation and evaluation, so they are
+// defined inline here where every translation unit can fold them into its own code. bitboard.c provides the
+// matching out-of-line definitions, so the exported symbols remain available to bindings and function pointers.
+
+#define _bb_flood(dir) inline BitBoard bb_flood_ ## dir (BitBoard board, BitBoard empty, bool captures) { \
+    BitBoard gen = board; \
+    for (int i = 0; i < 7; i++) { \
+        gen |= bb_slide_ ## dir (gen) & empty; \
+    } \
+    return captures ? bb_slide_ ## dir (gen) : gen & empty; \
+}
+
+#define _bb_blocker(dir) inline BitBoard bb_blocker_ ## dir (BitBoard board, BitBoard empty) { \
+    BitBoard gen = board; \
+    for (int i = 0; i < 7; i++) { \
+        gen = bb_slide_ ## dir (gen); \
+        if ((gen & empty) == 0) return gen; \
+    } \
+    return gen; \
+}
+
+#define _all_dirs(submacro) submacro(n) \
+    submacro(ne) \
+    submacro(e) \
+    submacro(se) \
+    submacro(s) \
+    submacro(sw) \
+    submacro(w) \
+    submacro(nw) \
+
 // Directional BitBoard slide functions translate the entire [board] in the given direction.
 
-BitBoard bb_slide_n(BitBoard board);
-BitBoard bb_slide_ne(BitBoard board);
-BitBoard bb_slide_e(BitBoard board);
-BitBoard bb_slide_se(BitBoard board);
-BitBoard bb_slide_s(BitBoard board);
-BitBoard bb_slide_sw(BitBoard board);
-BitBoard bb_slide_w(BitBoard board);
-BitBoard bb_slide_nw(BitBoard board);
+inline BitBoard bb_slide_n(BitBoard board) {
+    return board << 8;
+}
+
+inline BitBoard bb_slide_s(BitBoard board) {
+    return board >> 8;
+}
+
+inline BitBoard bb_slide_e(BitBoard board) {
+    return (board << 1) & 0xfefefefefefefefe;
+}
+
+inline BitBoard bb_slide_w(BitBoard board) {
+    return (board >> 1) & 0x7f7f7f7f7f7f7f7f;
+}
+
+inline BitBoard bb_slide_ne(BitBoard board) {
+    return (board << 9) & 0xfefefefefefefefe;
+}
+
+inline BitBoard bb_slide_se(BitBoard board) {
+    return (board >> 7) & 0xfefefefefefefefe;
+}
+
+inline BitBoard bb_slide_nw(BitBoard board) {
+    return (board << 7) & 0x7f7f7f7f7f7f7f7f;
+}
+
+inline BitBoard bb_slide_sw(BitBoard board) {
+    return (board >> 9) & 0x7f7f7f7f7f7f7f7f;
+}
 
 // Directional BitBoard flood functions travel from position [board] in the given direction
 // marking spaces until encountering an occluded space according to [empty], then return all
 // marked spaces. If [captures], then includes the occluded space.
 
-BitBoard bb_flood_n(BitBoard board, BitBoard empty, bool captures);
-BitBoard bb_flood_ne(BitBoard board, BitBoard empty, bool captures);
-BitBoard bb_flood_e(BitBoard board, BitBoard empty, bool captures);
-BitBoard bb_flood_se(BitBoard board, BitBoard empty, bool captures);
-BitBoard bb_flood_s(BitBoard board, BitBoard empty, bool captures);
-BitBoard bb_flood_sw(BitBoard board, BitBoard empty, bool captures);
-BitBoard bb_flood_w(BitBoard board, BitBoard empty, bool captures);
-BitBoard bb_flood_nw(BitBoard board, BitBoard empty, bool captures);
+_all_dirs(_bb_flood)
 
 // Directional BitBoard blocker functions travel from position [board] in the given direction
 // until encountering an occluded space according to [empty], then returns this occluded space.
 
-BitBoard bb_blocker_n(BitBoard board, BitBoard empty);
-BitBoard bb_blocker_ne(BitBoard board, BitBoard empty);
-BitBoard bb_blocker_e(BitBoard board, BitBoard empty);
-BitBoard bb_blocker_se(BitBoard board, BitBoard empty);
-BitBoard bb_blocker_s(BitBoard board, BitBoard empty);
-BitBoard bb_blocker_sw(BitBoard board, BitBoard empty);
-BitBoard bb_blocker_w(BitBoard board, BitBoard empty);
-BitBoard bb_blocker_nw(BitBoard board, BitBoard empty);
\ No newline at end of file
+_all_dirs(_bb_blocker)
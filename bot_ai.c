@@ -1,7 +1,18 @@
 #include "chessapi.h"
 #include <limits.h>
+#include <math.h>
+#include <stdatomic.h>
 #include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
+#include <time.h>
+
+#ifdef _WIN32
+#include "tinycthread.h"  // Windows: tinycthread provides C11 threads
+#else
+#include <threads.h>      // Unix/Linux: use native C11 threads
+#endif
 
 // --- Piece values ---
 int piece_value(PieceType piece) {
@@ -15,202 +26,1751 @@ int piece_value(PieceType piece) {
     }
 }
 
-// --- Board evaluation (material only, with repetition penalty) ---
-int evaluate_board(Board *board, uint64_t history[], int history_len) {
-    int score = 0;
+// --- Scores ---
+// Mate scores count down with the distance from the root, so nearer mates score higher.
+// Anything beyond MATE_BOUND is a mate; the evaluation is clamped to stay inside it.
+#define INF 32000
+#define MATE 30000
+#define MAX_PLY 128
+#define MATE_BOUND (MATE - MAX_PLY)
+#define ASPIRATION_WINDOW 40
+#define ASPIRATION_MIN_DEPTH 4
 
-    // --- Material evaluation ---
-    for (int piece = PAWN; piece <= KING; piece++) {
-        BitBoard w_bb = chess_get_bitboard(board, WHITE, piece);
-        BitBoard b_bb = chess_get_bitboard(board, BLACK, piece);
-        score += piece_value(piece) * (__builtin_popcountll(w_bb) - __builtin_popcountll(b_bb));
-    }
+// --- Board evaluation (material and piece-square tables) ---
+int evaluate_board(Board *board) {
+    BoardSnapshot snap;
+    chess_get_snapshot(board, &snap);
 
-    // --- Development bonus: knights and bishops off starting squares ---
-    BitBoard w_knight = chess_get_bitboard(board, WHITE, KNIGHT);
-    BitBoard w_bishop = chess_get_bitboard(board, WHITE, BISHOP);
-    BitBoard b_knight = chess_get_bitboard(board, BLACK, KNIGHT);
-    BitBoard b_bishop = chess_get_bitboard(board, BLACK, BISHOP);
+    // --- Material + piece-square tables (kept incrementally by the API) ---
+    int score = snap.psqt_score;
 
-    BitBoard w_dev = (w_knight & ~((1ULL << 1) | (1ULL << 6))) |
-                 (w_bishop & ~((1ULL << 2) | (1ULL << 5)));
+    // --- Development bonus: knights and bishops off starting squares ---
+    BitBoard w_dev = (snap.pieces[WHITE][KNIGHT] & ~((1ULL << 1) | (1ULL << 6))) |
+                     (snap.pieces[WHITE][BISHOP] & ~((1ULL << 2) | (1ULL << 5)));
 
-    BitBoard b_dev = (b_knight & ~((1ULL << 57) | (1ULL << 62))) |
-                     (b_bishop & ~((1ULL << 58) | (1ULL << 61)));
+    BitBoard b_dev = (snap.pieces[BLACK][KNIGHT] & ~((1ULL << 57) | (1ULL << 62))) |
+                     (snap.pieces[BLACK][BISHOP] & ~((1ULL << 58) | (1ULL << 61)));
 
     score += 15 * (__builtin_popcountll(w_dev) - __builtin_popcountll(b_dev));
 
     // --- Center control bonus ---
     BitBoard center = 1ULL << 27 | 1ULL << 28 | 1ULL << 35 | 1ULL << 36;
 
-    BitBoard w_center = (chess_get_bitboard(board, WHITE, PAWN) |
-                         chess_get_bitboard(board, WHITE, KNIGHT) |
-                         chess_get_bitboard(board, WHITE, BISHOP) |
-                         chess_get_bitboard(board, WHITE, QUEEN)) & center;
-
-    BitBoard b_center = (chess_get_bitboard(board, BLACK, PAWN) |
-                         chess_get_bitboard(board, BLACK, KNIGHT) |
-                         chess_get_bitboard(board, BLACK, BISHOP) |
-                         chess_get_bitboard(board, BLACK, QUEEN)) & center;
+    BitBoard w_center = (snap.pieces[WHITE][0] & ~(snap.pieces[WHITE][ROOK] | snap.pieces[WHITE][KING])) & center;
+    BitBoard b_center = (snap.pieces[BLACK][0] & ~(snap.pieces[BLACK][ROOK] | snap.pieces[BLACK][KING])) & center;
 
     score += 25 * (__builtin_popcountll(w_center) - __builtin_popcountll(b_center));
 
     // --- King safety / castling bonus ---
-    if (chess_can_kingside_castle(board, WHITE) || chess_can_queenside_castle(board, WHITE))
+    if (snap.can_kingside_castle[WHITE] || snap.can_queenside_castle[WHITE])
         score += 40;
-    if (chess_can_kingside_castle(board, BLACK) || chess_can_queenside_castle(board, BLACK))
+    if (snap.can_kingside_castle[BLACK] || snap.can_queenside_castle[BLACK])
         score -= 40;
 
-    // --- Penalize repeated positions ---
-    uint64_t hash = chess_zobrist_key(board);
-    int repeat_count = 0;
-    for (int i = 0; i < history_len; i++)
-        if (history[i] == hash) repeat_count++;
+    return score;
+}
+
+// Evaluation from the side to move's point of view, as negamax wants it
+int evaluate_relative(Board *board) {
+    int score = evaluate_board(board);
+    if (score > MATE_BOUND - 1) score = MATE_BOUND - 1;
+    if (score < -(MATE_BOUND - 1)) score = -(MATE_BOUND - 1);
+    return chess_is_white_turn(board) ? score : -score;
+}
+
+// --- Transposition table ---
+// Buckets are one cache line of four entries. Each entry stores its key xored with its data, so a
+// torn write from another thread fails the key check on probe instead of handing back a mixed entry.
+#define TT_DEFAULT_MB 64
+#define TT_MAX_MB 4096
+#define TT_BUCKET_ENTRIES 4
+
+enum { BOUND_NONE, BOUND_UPPER, BOUND_LOWER, BOUND_EXACT };
+
+typedef struct {
+    _Atomic uint64_t key;   // zobrist key ^ data
+    _Atomic uint64_t data;  // score:16 | move:15 | depth:8 | bound:2 | age:6
+} TTEntry;
+
+typedef struct {
+    _Alignas(64) TTEntry entries[TT_BUCKET_ENTRIES];
+} TTBucket;
+
+typedef struct {
+    Move move;
+    int score;
+    int depth;
+    int bound;
+} TTData;
+
+static TTBucket *tt_buckets = NULL;
+static void *tt_memory = NULL;      // the allocation tt_buckets was aligned within
+static size_t tt_bucket_count = 0;
+static size_t tt_megabytes = 0;
+static unsigned tt_age = 0;
+
+// Packs the squares and promotion of a move into 15 bits; 0 means no move
+uint64_t pack_move(Move m) {
+    if (!m.from || !m.to) return 0;
+    return (uint64_t)__builtin_ctzll(m.from) | ((uint64_t)__builtin_ctzll(m.to) << 6) | ((uint64_t)m.promotion << 12);
+}
+
+Move unpack_move(uint64_t packed) {
+    Move m = {0};
+    if (!packed) return m;
+    m.from = 1ULL << (packed & 63);
+    m.to = 1ULL << ((packed >> 6) & 63);
+    m.promotion = (uint8_t)((packed >> 12) & 7);
+    return m;
+}
+
+bool same_move(Move a, Move b) {
+    return a.from == b.from && a.to == b.to && a.promotion == b.promotion;
+}
+
+uint64_t tt_pack(int score, Move move, int depth, int bound) {
+    return (uint64_t)(uint16_t)(int16_t)score | (pack_move(move) << 16) | ((uint64_t)(uint8_t)depth << 31)
+        | ((uint64_t)bound << 39) | ((uint64_t)(tt_age & 63) << 41);
+}
+
+int tt_entry_age(uint64_t data) {
+    return (int)((data >> 41) & 63);
+}
+
+int tt_entry_depth(uint64_t data) {
+    return (int)((data >> 31) & 255);
+}
+
+// Sets the table size, discarding all entries
+void tt_init(size_t megabytes) {
+    free(tt_memory);
+    tt_megabytes = megabytes;
+    tt_bucket_count = megabytes * 1024 * 1024 / sizeof(TTBucket);
+    if (tt_bucket_count == 0) tt_bucket_count = 1;
+    // aligned by hand, since neither MSVC nor MinGW has aligned_alloc()
+    tt_memory = malloc(tt_bucket_count * sizeof(TTBucket) + sizeof(TTBucket) - 1);
+    tt_buckets = (TTBucket *)(((uintptr_t)tt_memory + sizeof(TTBucket) - 1) & ~(uintptr_t)(sizeof(TTBucket) - 1));
+    memset(tt_buckets, 0, tt_bucket_count * sizeof(TTBucket));
+    tt_age = 0;
+}
+
+// Empties the table, keeping its size
+void tt_clear(void) {
+    memset(tt_buckets, 0, tt_bucket_count * sizeof(TTBucket));
+    tt_age = 0;
+}
+
+// Marks the start of a new search, so entries from older searches are replaced first
+void tt_new_search(void) {
+    tt_age++;
+}
+
+// The high 64 bits of the 128-bit product a * b
+uint64_t mul_high(uint64_t a, uint64_t b) {
+#ifdef __SIZEOF_INT128__
+    return (uint64_t)(((unsigned __int128)a * b) >> 64);
+#else
+    uint64_t a_lo = (uint32_t)a, a_hi = a >> 32, b_lo = (uint32_t)b, b_hi = b >> 32;
+    uint64_t lo_lo = a_lo * b_lo, hi_lo = a_hi * b_lo, lo_hi = a_lo * b_hi, hi_hi = a_hi * b_hi;
+    uint64_t cross = (lo_lo >> 32) + (uint32_t)hi_lo + lo_hi;
+    return hi_hi + (hi_lo >> 32) + (cross >> 32);
+#endif
+}
+
+// Maps the key onto the buckets by its high bits, which is cheaper than a modulo for any table size
+TTBucket *tt_bucket(uint64_t key) {
+    return &tt_buckets[(size_t)mul_high(key, tt_bucket_count)];
+}
+
+// Prefetch hook for chess_make_move(), so the child's bucket is in cache by the time it's probed
+void tt_prefetch(uint64_t key, void *context) {
+    (void)context;
+    __builtin_prefetch(tt_bucket(key));
+}
+
+bool tt_probe(uint64_t key, TTData *out) {
+    TTBucket *bucket = tt_bucket(key);
+    for (int i = 0; i < TT_BUCKET_ENTRIES; i++) {
+        uint64_t data = atomic_load_explicit(&bucket->entries[i].data, memory_order_relaxed);
+        uint64_t check = atomic_load_explicit(&bucket->entries[i].key, memory_order_relaxed);
+        if ((check ^ data) != key || data == 0) continue;
+        out->score = (int16_t)(data & 0xFFFF);
+        out->move = unpack_move((data >> 16) & 0x7FFF);
+        out->depth = tt_entry_depth(data);
+        out->bound = (int)((data >> 39) & 3);
+        return true;
+    }
+    return false;
+}
+
+// Stores a result, replacing the same position if present, otherwise the shallowest entry with older searches going first
+void tt_store(uint64_t key, int depth, int bound, int score, Move move) {
+    TTBucket *bucket = tt_bucket(key);
+    TTEntry *victim = NULL;
+    int victim_value = INT_MAX;
+    for (int i = 0; i < TT_BUCKET_ENTRIES; i++) {
+        TTEntry *entry = &bucket->entries[i];
+        uint64_t data = atomic_load_explicit(&entry->data, memory_order_relaxed);
+        uint64_t check = atomic_load_explicit(&entry->key, memory_order_relaxed);
+        if ((check ^ data) == key) {
+            // keep the old move if this result didn't find one
+            if (!pack_move(move)) move = unpack_move((data >> 16) & 0x7FFF);
+            victim = entry;
+            break;
+        }
+        int value = tt_entry_depth(data) - 8 * (int)((tt_age - tt_entry_age(data)) & 63);
+        if (value < victim_value) {
+            victim_value = value;
+            victim = entry;
+        }
+    }
+    if (score > INT16_MAX) score = INT16_MAX;
+    if (score < -INT16_MAX) score = -INT16_MAX;
+    uint64_t data = tt_pack(score, move, depth, bound);
+    atomic_store_explicit(&victim->key, key ^ data, memory_order_relaxed);
+    atomic_store_explicit(&victim->data, data, memory_order_relaxed);
+}
+
+// Returns how full the table is in permille, sampled from the first buckets, counting only this search's entries
+int tt_hashfull(void) {
+    size_t sample = tt_bucket_count < 250 ? tt_bucket_count : 250;
+    int used = 0;
+    for (size_t b = 0; b < sample; b++) {
+        for (int i = 0; i < TT_BUCKET_ENTRIES; i++) {
+            uint64_t data = atomic_load_explicit(&tt_buckets[b].entries[i].data, memory_order_relaxed);
+            if (data != 0 && tt_entry_age(data) == (int)(tt_age & 63)) used++;
+        }
+    }
+    return (int)(used * 1000 / (sample * TT_BUCKET_ENTRIES));
+}
 
-    score -= repeat_count * 500;
+// Mate scores are stored relative to the node rather than the root, so they stay correct when reached via another path
+int score_to_tt(int score, int ply) {
+    if (score >= MATE_BOUND) return score + ply;
+    if (score <= -MATE_BOUND) return score - ply;
+    return score;
+}
 
+int score_from_tt(int score, int ply) {
+    if (score >= MATE_BOUND) return score - ply;
+    if (score <= -MATE_BOUND) return score + ply;
     return score;
 }
 
-// --- Check if move would cause a threefold repetition ---
-bool would_repeat(Board *board, Move m, uint64_t history[], int history_len) {
-    // Include the current board as the first occurrence
-    uint64_t current_hash = chess_zobrist_key(board);
+// --- Repetition detection ---
+// Each thread keeps a stack of the keys from the game's last irreversible move down to the node it is searching.
+// A node only looks back as far as its half move counter, and only at positions with the same side to move.
+typedef struct {
+    uint64_t *keys;
+    int len;
+    int capacity;
+} KeyStack;
+
+void keys_reserve(KeyStack *stack, int capacity) {
+    if (capacity <= stack->capacity) return;
+    stack->keys = realloc(stack->keys, capacity * sizeof(uint64_t));
+    stack->capacity = capacity;
+}
+
+void keys_push(KeyStack *stack, uint64_t key) {
+    if (stack->len == stack->capacity)
+        keys_reserve(stack, stack->capacity ? stack->capacity * 2 : 64);
+    stack->keys[stack->len++] = key;
+}
+
+void keys_pop(KeyStack *stack) {
+    stack->len--;
+}
+
+// True if the position on top of [stack], [ply] moves from the root, should be scored as a draw.
+// A repetition inside the search is a draw already, since the side that allowed it could do so again;
+// repeating a position from before the root takes a second earlier occurrence, as in the game itself.
+bool is_repetition(const KeyStack *stack, int halfmoves, int ply) {
+    int top = stack->len - 1;
+    uint64_t key = stack->keys[top];
+    int limit = halfmoves < top ? halfmoves : top;
+    bool seen = false;
+    for (int back = 4; back <= limit; back += 2) {
+        if (stack->keys[top - back] != key) continue;
+        if (back < ply || seen) return true;
+        seen = true;
+    }
+    return false;
+}
+
+// --- Move ordering ---
+// Hash move first, then captures by MVV-LVA, then killers and the countermove, then quiet moves by history.
+#define MAX_MOVES 256
+#define SCORE_HASH_MOVE   (1 << 30)
+#define SCORE_CAPTURE     (1 << 26)
+#define SCORE_KILLER      (1 << 24)
+#define SCORE_COUNTERMOVE (1 << 23)
+#define HISTORY_MAX       (1 << 22)
+
+// --- Per-thread search state ---
+// Everything a search writes to besides the transposition table, so threads never share it.
+typedef struct {
+    int id;                       // 0 is the main thread, which owns the clock and the pushed move
+    Board *board;                 // helpers search their own detached clone
+    Move killers[MAX_PLY][2];
+    int history[2][64][64];       // [side to move][from][to]
+    Move countermoves[64][64];    // [previous move from][previous move to]
+    _Atomic uint64_t nodes;       // only this thread writes these two, but the main thread reads them for its reports
+    _Atomic int seldepth;
+    uint64_t cutoffs;
+    uint64_t first_move_cutoffs;
+    KeyStack keys;                // positions from the last irreversible move to the current node
+    // triangular principal variation table: pv[ply] holds the best line found so far from the node at [ply]
+    Move pv[MAX_PLY + 1][MAX_PLY + 1];
+    int pv_length[MAX_PLY + 1];
+    // result of the deepest iteration this thread completed
+    int completed_depth;
+    Move best_move;
+    int best_score;
+    Move best_pv[MAX_PLY + 1];
+    int best_pv_length;
+    // work stealing, see "Young brothers wait" below
+    struct TaskDeque *deque;      // moves this thread has offered for others to search
+    struct SplitPoint *split;     // innermost split point this thread is searching a move of, if any
+} SearchThread;
+
+#define MAX_THREADS 256
+
+static SearchThread *search_threads = NULL;
+static int thread_count = 0;
+static int active_threads = 1;    // the threads taking part in the current search
+
+typedef struct {
+    Move *moves;
+    int scores[MAX_MOVES];
+    int len;
+    int next;
+} MovePicker;
+
+int ordering_value(PieceType piece) {
+    return piece == KING ? 6 : piece_value(piece) / 100;
+}
+
+int score_move(SearchThread *t, Board *board, Move m, Move hash_move, int ply, Move counter) {
+    if (same_move(m, hash_move))
+        return SCORE_HASH_MOVE;
+    if (m.capture || m.promotion) {
+        // en passant lands on an empty square, but takes a pawn
+        PieceType victim = chess_get_piece_from_bitboard(board, m.to);
+        int gain = m.capture ? ordering_value(victim ? victim : PAWN) : 0;
+        if (m.promotion) gain += ordering_value((PieceType)m.promotion);
+        return SCORE_CAPTURE + gain * 16 - ordering_value(chess_get_piece_from_bitboard(board, m.from));
+    }
+    if (ply < MAX_PLY && same_move(m, t->killers[ply][0]))
+        return SCORE_KILLER + 1;
+    if (ply < MAX_PLY && same_move(m, t->killers[ply][1]))
+        return SCORE_KILLER;
+    if (same_move(m, counter))
+        return SCORE_COUNTERMOVE;
+    return t->history[chess_is_white_turn(board) ? 0 : 1][__builtin_ctzll(m.from)][__builtin_ctzll(m.to)];
+}
+
+Move countermove_for(SearchThread *t, Move prev) {
+    if (!prev.from || !prev.to) return (Move){0};
+    return t->countermoves[__builtin_ctzll(prev.from)][__builtin_ctzll(prev.to)];
+}
+
+void picker_init(SearchThread *t, MovePicker *picker, Move *moves, int len, Move hash_move, int ply, Move prev) {
+    Move counter = countermove_for(t, prev);
+    picker->moves = moves;
+    picker->len = len < MAX_MOVES ? len : MAX_MOVES;
+    picker->next = 0;
+    for (int i = 0; i < picker->len; i++)
+        picker->scores[i] = score_move(t, t->board, moves[i], hash_move, ply, counter);
+}
+
+// Selection sort one step at a time, so a cutoff on an early move doesn't pay for sorting the rest
+bool picker_next(MovePicker *picker, Move *out) {
+    if (picker->next >= picker->len) return false;
+    int best = picker->next;
+    for (int i = picker->next + 1; i < picker->len; i++)
+        if (picker->scores[i] > picker->scores[best]) best = i;
+    Move m = picker->moves[best];
+    int score = picker->scores[best];
+    picker->moves[best] = picker->moves[picker->next];
+    picker->scores[best] = picker->scores[picker->next];
+    picker->moves[picker->next] = m;
+    picker->scores[picker->next] = score;
+    picker->next++;
+    *out = m;
+    return true;
+}
+
+// Records a quiet move that caused a cutoff, [searched] moves into the node
+void update_quiet_cutoff(SearchThread *t, Move m, int depth, int ply, Move prev) {
+    if (ply < MAX_PLY && !same_move(m, t->killers[ply][0])) {
+        t->killers[ply][1] = t->killers[ply][0];
+        t->killers[ply][0] = m;
+    }
+    int *entry = &t->history[chess_is_white_turn(t->board) ? 0 : 1][__builtin_ctzll(m.from)][__builtin_ctzll(m.to)];
+    *entry += depth * depth;
+    if (*entry > HISTORY_MAX) {
+        // keep history below the killer scores by scaling everything down
+        for (int c = 0; c < 2; c++)
+            for (int f = 0; f < 64; f++)
+                for (int to = 0; to < 64; to++)
+                    t->history[c][f][to] /= 2;
+    }
+    if (prev.from && prev.to)
+        t->countermoves[__builtin_ctzll(prev.from)][__builtin_ctzll(prev.to)] = m;
+}
+
+// Makes [move] followed by the line of the child it leads to the best line from [ply]
+void update_pv(SearchThread *t, int ply, Move move) {
+    int child = t->pv_length[ply + 1];
+    t->pv[ply][0] = move;
+    memcpy(&t->pv[ply][1], t->pv[ply + 1], child * sizeof(Move));
+    t->pv_length[ply] = child + 1;
+}
+
+// Counts a node, and records how deep the search has gone
+void visit_node(SearchThread *t, int ply) {
+    atomic_store_explicit(&t->nodes, atomic_load_explicit(&t->nodes, memory_order_relaxed) + 1, memory_order_relaxed);
+    if (ply > atomic_load_explicit(&t->seldepth, memory_order_relaxed))
+        atomic_store_explicit(&t->seldepth, ply, memory_order_relaxed);
+}
+
+void record_cutoff(SearchThread *t, int searched) {
+    t->cutoffs++;
+    if (searched == 1) t->first_move_cutoffs++;
+}
+
+// Clears killers and ages history at the start of a search
+void ordering_new_search(SearchThread *t) {
+    memset(t->killers, 0, sizeof(t->killers));
+    for (int c = 0; c < 2; c++)
+        for (int f = 0; f < 64; f++)
+            for (int to = 0; to < 64; to++)
+                t->history[c][f][to] /= 8;
+    t->cutoffs = 0;
+    t->first_move_cutoffs = 0;
+}
+
+// Forgets everything learned in earlier searches, for searches that must not depend on them
+void ordering_clear(SearchThread *t) {
+    memset(t->killers, 0, sizeof(t->killers));
+    memset(t->history, 0, sizeof(t->history));
+    memset(t->countermoves, 0, sizeof(t->countermoves));
+}
+
+// --- Split points ---
+// In the work-stealing mode a node whose eldest brother has been searched hands its remaining moves out as tasks.
+// The split point holds what a thread needs to search one of them, and collects the results.
+#define DEQUE_CAPACITY 1024
+
+typedef struct {
+    int depth;
+    int ply;
+    int beta;
+    bool pv_node;
+    bool in_check;
+    int static_eval;
+} NodeInfo;
+
+typedef struct SplitPoint {
+    struct SplitPoint *parent;    // split point the owner was searching a move of; its cutoff cancels this one too
+    Board *board;                 // detached copy of the position, for thieves to clone
+    const uint64_t *keys;         // the key stack as far back as repetitions can reach, ending with this node
+    int keys_len;
+    NodeInfo node;
+    Move prev;
+    mtx_t lock;                   // guards the results below
+    int alpha;
+    int best_score;
+    Move best_move;
+    int searched;
+    Move pv[MAX_PLY + 1];         // the line of the move that last raised alpha
+    int pv_length;
+    atomic_bool cutoff;
+    atomic_int pending;           // tasks not yet finished; the split point lives until this reaches 0
+} SplitPoint;
+
+typedef struct {
+    SplitPoint *split;
+    Move move;
+    int index;                    // position in the node's move list, for the reductions
+    int quiets_before;
+} Task;
+
+// The owner pushes and pops at the bottom, thieves take from the top, where the oldest and largest tasks are
+typedef struct TaskDeque {
+    mtx_t lock;
+    Task tasks[DEQUE_CAPACITY];
+    int top;
+    int bottom;
+} TaskDeque;
+
+static bool use_ybwc = false;
+
+// --- Time management ---
+// The soft deadline is the time we aim to use for the move, the hard one aborts the iteration in progress.
+#define MAX_DEPTH 64
+#define MOVE_OVERHEAD_MS 30
+#define STOP_CHECK_NODES 1024
+#define STOP_POLL_NODES 128
+
+static uint64_t soft_deadline = 0;
+static uint64_t hard_deadline = 0;
+static atomic_bool search_aborted = false;
+static SearchLimits limits;           // what the GUI asked of the current search
+static int fixed_depth = MAX_DEPTH;   // from the command line, for analysis jobs
+static int depth_limit = MAX_DEPTH;
+static uint64_t node_limit = 0;
+static bool pondering = false;
+static bool clock_given = false;      // an empty clock still means we are playing on time
+// a bench searches its own boards without the chess server, so nothing may poll or report to it
+static bool benching = false;
+
+void plan_time(void) {
+    // depth, node and mate limited searches ignore the clock, and so do infinite ones, ones without a clock at all,
+    // and pondering until the GUI tells us how it went
+    pondering = chess_is_pondering();
+    uint64_t movetime = chess_get_movetime();
+    uint64_t left = chess_get_time_millis();
+    if (pondering || limits.infinite || depth_limit < MAX_DEPTH || node_limit > 0 || (movetime == 0 && !clock_given)) {
+        soft_deadline = hard_deadline = UINT64_MAX;
+        return;
+    }
+
+    // a fixed move time is there to be used, so no iteration is skipped to save time for later moves
+    if (movetime > 0) {
+        soft_deadline = UINT64_MAX;
+        hard_deadline = movetime > MOVE_OVERHEAD_MS ? movetime - MOVE_OVERHEAD_MS : 1;
+        return;
+    }
+
+    uint64_t opponent = chess_get_opponent_time_millis();
+    uint64_t increment = chess_get_increment_millis();
+    int movestogo = chess_get_movestogo();
+
+    // out of time already, so move at once, or within what the increment gives back if the GUI lets us play on
+    if (left == 0) {
+        soft_deadline = hard_deadline = increment * 3 / 4 > MOVE_OVERHEAD_MS ? increment * 3 / 4 - MOVE_OVERHEAD_MS : 1;
+        return;
+    }
+    uint64_t usable = left > MOVE_OVERHEAD_MS ? left - MOVE_OVERHEAD_MS : 1;
+
+    // share the clock over 30 more moves, or fewer if it is topped up sooner, plus most of the increment
+    uint64_t moves_left = movestogo > 0 && movestogo < 30 ? (uint64_t)movestogo : 30;
+    soft_deadline = usable / moves_left + increment * 3 / 4;
+    // spend some of a clock lead, but never more than a tenth of what's left
+    if (left > opponent)
+        soft_deadline += (left - opponent) / 20 < usable / 10 ? (left - opponent) / 20 : usable / 10;
+    // the increment only arrives after the move, so it can't make up for an empty clock
+    if (soft_deadline > usable * 3 / 4)
+        soft_deadline = usable * 3 / 4;
+    if (soft_deadline == 0)
+        soft_deadline = 1;
+
+    hard_deadline = soft_deadline * 3 < usable / 8 ? soft_deadline * 3 : usable / 8;
+    if (hard_deadline < soft_deadline)
+        hard_deadline = soft_deadline;
+}
+
+bool aborted(void) {
+    return atomic_load_explicit(&search_aborted, memory_order_relaxed);
+}
+
+// True once the search is aborted, or a split point this thread is working under has had a beta cutoff
+bool stopped(SearchThread *t) {
+    if (aborted())
+        return true;
+    for (SplitPoint *sp = t->split; sp; sp = sp->parent)
+        if (atomic_load_explicit(&sp->cutoff, memory_order_relaxed))
+            return true;
+    return false;
+}
+
+// Polled by the main thread. A ponderhit turns a ponder search into a timed one, with the clock starting now.
+void check_clock(void) {
+    if (chess_should_stop())
+        atomic_store_explicit(&search_aborted, true, memory_order_relaxed);
+    else if (pondering && !chess_is_pondering())
+        plan_time();
+    else if (chess_get_elapsed_time_millis() >= hard_deadline)
+        atomic_store_explicit(&search_aborted, true, memory_order_relaxed);
+}
+
+// Counts a node at [ply] and returns true once the search should stop. Only the main thread watches the clock.
+bool should_abort(SearchThread *t, int ply) {
+    if (aborted())
+        return true;
+    visit_node(t, ply);
+    uint64_t nodes = atomic_load_explicit(&t->nodes, memory_order_relaxed);
+    // a node limited search runs on the main thread alone, so it stops on exactly the same node every time
+    if (node_limit > 0 && nodes >= node_limit)
+        atomic_store_explicit(&search_aborted, true, memory_order_relaxed);
+    else if (benching)
+        ;
+    else if ((nodes % STOP_CHECK_NODES) == 0 && t->id == 0)
+        check_clock();
+    // "stop" is a lock-free flag, so every thread can look at it far more often than at the clock
+    else if ((nodes % STOP_POLL_NODES) == 0 && chess_should_stop())
+        atomic_store_explicit(&search_aborted, true, memory_order_relaxed);
+    return stopped(t);
+}
+
+// A ponder or infinite search that finishes early must still wait for the GUI before answering
+void wait_for_gui(void) {
+    while ((chess_is_pondering() || limits.infinite) && !chess_should_stop())
+        thrd_sleep(&(struct timespec){ .tv_nsec = 500000 }, NULL);
+}
+
+// --- Static exchange evaluation ---
+PieceType piece_on(const BoardSnapshot *snap, BitBoard square, PlayerColor *color) {
+    for (int c = WHITE; c <= BLACK; c++) {
+        if (!(snap->pieces[c][0] & square)) continue;
+        *color = (PlayerColor)c;
+        for (int p = PAWN; p <= KING; p++)
+            if (snap->pieces[c][p] & square) return (PieceType)p;
+    }
+    return (PieceType)0;
+}
+
+// Every piece of either color attacking [square], given [occupied] as the blockers
+BitBoard attackers_to(const BoardSnapshot *snap, BitBoard square, BitBoard occupied) {
+    BitBoard empty = ~occupied;
+    BitBoard straight = snap->pieces[WHITE][ROOK] | snap->pieces[WHITE][QUEEN] | snap->pieces[BLACK][ROOK] | snap->pieces[BLACK][QUEEN];
+    BitBoard diagonal = snap->pieces[WHITE][BISHOP] | snap->pieces[WHITE][QUEEN] | snap->pieces[BLACK][BISHOP] | snap->pieces[BLACK][QUEEN];
+    BitBoard knights = snap->pieces[WHITE][KNIGHT] | snap->pieces[BLACK][KNIGHT];
+    BitBoard kings = snap->pieces[WHITE][KING] | snap->pieces[BLACK][KING];
+    BitBoard ring = square | bb_slide_e(square) | bb_slide_w(square);
+    ring |= bb_slide_n(ring) | bb_slide_s(ring);
+    BitBoard east = bb_slide_e(square), west = bb_slide_w(square);
+    BitBoard east2 = bb_slide_e(east), west2 = bb_slide_w(west);
+    BitBoard knight_squares = bb_slide_n(bb_slide_n(east | west)) | bb_slide_s(bb_slide_s(east | west))
+        | bb_slide_n(east2 | west2) | bb_slide_s(east2 | west2);
+    return ((bb_slide_sw(square) | bb_slide_se(square)) & snap->pieces[WHITE][PAWN])
+        | ((bb_slide_nw(square) | bb_slide_ne(square)) & snap->pieces[BLACK][PAWN])
+        | (knight_squares & knights)
+        | (ring & kings)
+        | ((bb_flood_n(square, empty, true) | bb_flood_e(square, empty, true)
+            | bb_flood_s(square, empty, true) | bb_flood_w(square, empty, true)) & straight)
+        | ((bb_flood_ne(square, empty, true) | bb_flood_nw(square, empty, true)
+            | bb_flood_se(square, empty, true) | bb_flood_sw(square, empty, true)) & diagonal);
+}
+
+// Material balance for the side making capture [m] once all exchanges on its target square are played out
+int see(const BoardSnapshot *snap, Move m) {
+    int gain[32];
+    int d = 0;
+    PlayerColor side = WHITE, ignored;
+    PieceType attacker = piece_on(snap, m.from, &side);
+    PieceType victim = piece_on(snap, m.to, &ignored);
+    BitBoard occupied = snap->occupied;
+    BitBoard from = m.from;
+    gain[0] = piece_value(victim ? victim : PAWN);
+    while (d < 31) {
+        d++;
+        gain[d] = piece_value(attacker) - gain[d - 1];
+        // neither side can come out ahead by continuing
+        if ((-gain[d - 1] > gain[d] ? -gain[d - 1] : gain[d]) < 0) break;
+        occupied ^= from;
+        side = side == WHITE ? BLACK : WHITE;
+        BitBoard attackers = attackers_to(snap, m.to, occupied) & occupied & snap->pieces[side][0];
+        if (!attackers) break;
+        for (int p = PAWN; p <= KING; p++) {
+            BitBoard of_type = attackers & snap->pieces[side][p];
+            if (of_type) {
+                from = of_type & -of_type;
+                attacker = (PieceType)p;
+                break;
+            }
+        }
+    }
+    while (--d)
+        gain[d - 1] = -(-gain[d - 1] > gain[d] ? -gain[d - 1] : gain[d]);
+    return gain[0];
+}
 
-    chess_make_move(board, m);
-    uint64_t new_hash = chess_zobrist_key(board);
+// --- Quiescence search: only captures and promotions, until the position is quiet ---
+#define DELTA_MARGIN 200
+
+static bool qsearch_see = true;
+
+int quiescence(SearchThread *t, int alpha, int beta, int ply) {
+    Board *board = t->board;
+    if (should_abort(t, ply))
+        return 0;
+
+    int stand_pat = evaluate_relative(board);
+    if (ply >= MAX_PLY)
+        return stand_pat;
+
+    // the side to move can always decline to capture
+    if (stand_pat >= beta)
+        return stand_pat;
+    if (stand_pat > alpha)
+        alpha = stand_pat;
+
+    int len;
+    Move *moves = chess_get_legal_captures(board, &len);
+    if (len == 0) {
+        chess_free_moves_array(moves);
+        return stand_pat;
+    }
+
+    BoardSnapshot snap;
+    chess_get_snapshot(board, &snap);
+    MovePicker picker;
+    picker_init(t, &picker, moves, len, (Move){0}, MAX_PLY, (Move){0});
+
+    int best_score = stand_pat;
+    Move move;
+    while (picker_next(&picker, &move)) {
+        PlayerColor ignored;
+        PieceType victim = piece_on(&snap, move.to, &ignored);
+        int gain = move.capture ? piece_value(victim ? victim : PAWN) : 0;
+        if (move.promotion) gain += piece_value((PieceType)move.promotion) - piece_value(PAWN);
+
+        // delta pruning: even winning this piece outright can't raise alpha
+        if (stand_pat + gain + DELTA_MARGIN <= alpha)
+            continue;
+        // losing captures, only worth checking when the capturing piece is worth more than its victim
+        if (qsearch_see && move.capture && !move.promotion
+            && piece_value(piece_on(&snap, move.from, &ignored)) > gain && see(&snap, move) < 0)
+            continue;
+
+        chess_make_move(board, move);
+        int score = -quiescence(t, -beta, -alpha, ply + 1);
+        chess_undo_move(board);
+
+        if (stopped(t)) {
+            chess_free_moves_array(moves);
+            return 0;
+        }
+
+        if (score > best_score) best_score = score;
+        if (score > alpha) alpha = score;
+        if (alpha >= beta)
+            break;
+    }
+
+    chess_free_moves_array(moves);
+    return best_score;
+}
+
+// --- Selectivity ---
+// Each technique can be switched off from the command line for A/B testing, see main().
+#define NMP_MIN_DEPTH 3
+#define RFP_MAX_DEPTH 6
+#define RFP_MARGIN 100
+#define FUTILITY_MAX_DEPTH 2
+#define LMR_MIN_DEPTH 3
+#define LMR_FULL_MOVES 3
+#define LMP_MAX_DEPTH 3
+
+static bool use_null_move = true;
+static bool use_lmr = true;
+static bool use_futility = true;
+static bool use_lmp = true;
+
+static const int futility_margin[FUTILITY_MAX_DEPTH + 1] = {0, 150, 300};
+static int lmr_table[MAX_DEPTH + 1][MAX_MOVES];
+
+void init_lmr_table(void) {
+    for (int depth = 1; depth <= MAX_DEPTH; depth++)
+        for (int moves = 1; moves < MAX_MOVES; moves++)
+            lmr_table[depth][moves] = (int)(0.75 + log(depth) * log(moves) / 2.25);
+}
+
+// Null move pruning is unsound in zugzwang, which mostly happens when the side to move has only pawns left
+bool has_non_pawn_material(Board *board) {
+    PlayerColor side = chess_is_white_turn(board) ? WHITE : BLACK;
+    return (chess_get_bitboard(board, side, KNIGHT) | chess_get_bitboard(board, side, BISHOP)
+        | chess_get_bitboard(board, side, ROOK) | chess_get_bitboard(board, side, QUEEN)) != 0;
+}
+
+// --- Searching one move of a node ---
+#define MOVE_SKIPPED INT_MIN
+
+int negamax(SearchThread *t, int depth, int alpha, int beta, int ply, Move prev);
+
+// Searches [move] as the [searched]th move tried at [node], after [quiets_searched] quiet ones, with late move
+// reductions and a null window for all but the first. Returns MOVE_SKIPPED if the move was pruned.
+int search_move(SearchThread *t, const NodeInfo *node, Move move, int searched, int quiets_searched, int alpha, int best_score) {
+    Board *board = t->board;
+    int depth = node->depth;
+    int beta = node->beta;
+    bool quiet = !move.capture && !move.promotion;
+    // prune quiet moves late in the list near the leaves, but never before one move has been searched
+    bool may_prune = !node->pv_node && !node->in_check && quiet && searched > 0 && best_score > -MATE_BOUND;
+    bool lmp_prune = use_lmp && may_prune && depth <= LMP_MAX_DEPTH && quiets_searched >= 3 + depth * depth;
+    bool futility_prune = use_futility && may_prune && depth <= FUTILITY_MAX_DEPTH
+        && node->static_eval + futility_margin[depth] <= alpha;
+
+    // Temporarily make move
+    chess_make_move(board, move);
+    bool gives_check = (lmp_prune || futility_prune || quiet) && chess_in_check(board);
+
+    if ((lmp_prune || futility_prune) && !gives_check) {
+        chess_undo_move(board);
+        return MOVE_SKIPPED;
+    }
+
+    keys_push(&t->keys, chess_zobrist_key(board));
+    int ply = node->ply;
+    int score;
+    if (searched == 0) {
+        score = -negamax(t, depth - 1, -beta, -alpha, ply + 1, move);
+    } else {
+        // --- Late move reductions: quiet moves this far down the list rarely matter ---
+        int reduction = 0;
+        if (use_lmr && quiet && !node->in_check && !gives_check && depth >= LMR_MIN_DEPTH && searched >= LMR_FULL_MOVES) {
+            reduction = lmr_table[depth < MAX_DEPTH ? depth : MAX_DEPTH][searched < MAX_MOVES ? searched : MAX_MOVES - 1];
+            if (node->pv_node && reduction > 0) reduction--;
+            if (reduction > depth - 2) reduction = depth - 2;
+        }
+        score = -negamax(t, depth - 1 - reduction, -alpha - 1, -alpha, ply + 1, move);
+        if (reduction > 0 && score > alpha)
+            score = -negamax(t, depth - 1, -alpha - 1, -alpha, ply + 1, move);
+        if (score > alpha && score < beta)
+            score = -negamax(t, depth - 1, -beta, -alpha, ply + 1, move);
+    }
+
+    keys_pop(&t->keys);
     chess_undo_move(board);
+    return score;
+}
 
-    int count = 0;
-    // count occurrences in history
-    for (int i = 0; i < history_len; i++)
-        if (history[i] == new_hash)
-            count++;
+// --- Young brothers wait ---
+// Once the eldest brother of a node has been searched without a cutoff, the remaining moves go on the owner's deque.
+// Idle threads steal them from the top while the owner works through them from the bottom, and a cutoff found by
+// anyone cancels the siblings, and everything below them, through the split point chain checked by stopped().
+#define YBWC_MIN_DEPTH 4
+
+// Pops the bottom task of [deque] if it belongs to [sp]; older tasks are left for thieves
+bool deque_pop(TaskDeque *deque, SplitPoint *sp, Task *out) {
+    bool found = false;
+    mtx_lock(&deque->lock);
+    if (deque->bottom > deque->top && deque->tasks[deque->bottom - 1].split == sp) {
+        *out = deque->tasks[--deque->bottom];
+        found = true;
+    }
+    mtx_unlock(&deque->lock);
+    return found;
+}
+
+bool deque_steal(TaskDeque *deque, Task *out) {
+    bool found = false;
+    mtx_lock(&deque->lock);
+    if (deque->bottom > deque->top) {
+        *out = deque->tasks[deque->top++];
+        found = true;
+    }
+    mtx_unlock(&deque->lock);
+    return found;
+}
+
+// Takes a task from another thread's deque, starting with the next thread along so thieves spread out
+bool steal_task(SearchThread *t, Task *out) {
+    for (int i = 1; i < active_threads; i++)
+        if (deque_steal(search_threads[(t->id + i) % active_threads].deque, out))
+            return true;
+    return false;
+}
+
+// Searches the move of [task] and merges the result into its split point. The owner searches its own tasks
+// on its board, which is already at the split position; anyone else searches a clone.
+void run_task(SearchThread *t, Task *task, bool at_position) {
+    SplitPoint *sp = task->split;
+    Board *own_board = t->board;
+    SplitPoint *outer = t->split;
+    const NodeInfo node = sp->node;
+    int own_keys = t->keys.len;
+    if (!at_position) {
+        t->board = chess_clone_board_detached(sp->board);
+        for (int i = 0; i < sp->keys_len; i++)
+            keys_push(&t->keys, sp->keys[i]);
+    }
+    t->split = sp;
+
+    mtx_lock(&sp->lock);
+    int alpha = sp->alpha;
+    int best_score = sp->best_score;
+    mtx_unlock(&sp->lock);
+
+    int score = MOVE_SKIPPED;
+    if (!stopped(t))
+        score = search_move(t, &node, task->move, task->index, task->quiets_before, alpha, best_score);
+
+    // a cancelled search returns garbage, and a skipped move has nothing to report
+    bool cutoff = false;
+    if (score != MOVE_SKIPPED && !stopped(t)) {
+        mtx_lock(&sp->lock);
+        sp->searched++;
+        if (score > sp->best_score) {
+            sp->best_score = score;
+            sp->best_move = task->move;
+        }
+        if (score > sp->alpha) {
+            sp->alpha = score;
+            int child = t->pv_length[node.ply + 1];
+            sp->pv[0] = task->move;
+            memcpy(&sp->pv[1], t->pv[node.ply + 1], child * sizeof(Move));
+            sp->pv_length = child + 1;
+        }
+        if (sp->alpha >= node.beta && !atomic_load(&sp->cutoff)) {
+            atomic_store(&sp->cutoff, true);
+            cutoff = true;
+        }
+        mtx_unlock(&sp->lock);
+    }
+    if (cutoff) {
+        record_cutoff(t, task->index + 1);
+        if (!task->move.capture && !task->move.promotion)
+            update_quiet_cutoff(t, task->move, node.depth, node.ply, sp->prev);
+    }
+
+    t->split = outer;
+    if (!at_position) {
+        chess_free_board(t->board);
+        t->keys.len = own_keys;
+        t->board = own_board;
+    }
+    // last, since the owner may free the split point as soon as this reaches 0
+    atomic_fetch_sub(&sp->pending, 1);
+}
+
+// Copies PV rows [from, to] of [t] aside, for restore_pv_rows() to put back; NULL if the range is empty
+Move *save_pv_rows(SearchThread *t, int from, int to, int *lengths) {
+    if (from > to)
+        return NULL;
+    Move *saved = malloc((size_t)(to - from + 1) * (MAX_PLY + 1) * sizeof(Move));
+    for (int r = from; r <= to; r++) {
+        lengths[r] = t->pv_length[r];
+        memcpy(saved + (r - from) * (MAX_PLY + 1), t->pv[r], t->pv_length[r] * sizeof(Move));
+    }
+    return saved;
+}
 
-    // include current board hash as part of the path
-    if (new_hash == current_hash)
+void restore_pv_rows(SearchThread *t, int from, int to, const int *lengths, Move *saved) {
+    if (saved == NULL)
+        return;
+    for (int r = from; r <= to; r++) {
+        t->pv_length[r] = lengths[r];
+        memcpy(t->pv[r], saved + (r - from) * (MAX_PLY + 1), lengths[r] * sizeof(Move));
+    }
+    free(saved);
+}
+
+// Hands the moves left in [picker] out as tasks and helps search them until all are done, then folds the results
+// into [alpha], [best_score], [best_move] and [searched]. Returns false, having taken no moves, if it didn't split.
+bool split(SearchThread *t, MovePicker *picker, const NodeInfo *node, Move prev,
+           int *alpha, int *best_score, Move *best_move, int *searched, int quiets_searched) {
+    TaskDeque *deque = t->deque;
+    int remaining = picker->len - picker->next;
+    if (remaining < 2)
+        return false;
+    mtx_lock(&deque->lock);
+    if (deque->top == deque->bottom)
+        deque->top = deque->bottom = 0;
+    bool room = deque->bottom + remaining <= DEQUE_CAPACITY;
+    mtx_unlock(&deque->lock);
+    if (!room)
+        return false;
+
+    // the owner's stack may be reallocated while thieves are copying from it, so they get their own copy
+    int window = chess_get_half_moves(t->board) + 1;
+    if (window > t->keys.len) window = t->keys.len;
+    uint64_t *keys = malloc(window * sizeof(uint64_t));
+    memcpy(keys, t->keys.keys + t->keys.len - window, window * sizeof(uint64_t));
+    SplitPoint sp = {
+        .parent = t->split,
+        .board = chess_clone_board_detached(t->board),
+        .keys = keys,
+        .keys_len = window,
+        .node = *node,
+        .prev = prev,
+        .alpha = *alpha,
+        .best_score = *best_score,
+        .best_move = *best_move,
+        .searched = *searched,
+    };
+    mtx_init(&sp.lock, mtx_plain);
+    atomic_init(&sp.cutoff, false);
+
+    Task tasks[MAX_MOVES];
+    int count = 0;
+    int quiets = quiets_searched;
+    Move move;
+    while (picker_next(picker, &move)) {
+        tasks[count] = (Task){ .split = &sp, .move = move, .index = *searched + count, .quiets_before = quiets };
+        if (!move.capture && !move.promotion) quiets++;
         count++;
+    }
+    atomic_init(&sp.pending, count);
 
-    return count >= 3;
+    // pushed in reverse, so the owner pops them in move ordering order
+    mtx_lock(&deque->lock);
+    for (int i = count - 1; i >= 0; i--)
+        deque->tasks[deque->bottom++] = tasks[i];
+    mtx_unlock(&deque->lock);
+
+    // help with our own tasks first, then with anyone's, until the thieves have finished theirs
+    while (atomic_load(&sp.pending) > 0) {
+        Task task;
+        if (deque_pop(deque, &sp, &task)) {
+            run_task(t, &task, true);
+        } else if (steal_task(t, &task)) {
+            // a task from a split nearer the root searches its subtree on the PV rows of our own nodes
+            // still open up to this one, so those rows are put back once it's done
+            int from = task.split->node.ply + 1;
+            int lengths[MAX_PLY + 1];
+            Move *saved = save_pv_rows(t, from, node->ply, lengths);
+            run_task(t, &task, false);
+            restore_pv_rows(t, from, node->ply, lengths, saved);
+        } else {
+            thrd_yield();
+        }
+    }
+
+    *alpha = sp.alpha;
+    *best_score = sp.best_score;
+    *best_move = sp.best_move;
+    *searched = sp.searched;
+    if (sp.pv_length > 0) {
+        memcpy(t->pv[node->ply], sp.pv, sp.pv_length * sizeof(Move));
+        t->pv_length[node->ply] = sp.pv_length;
+    }
+    mtx_destroy(&sp.lock);
+    chess_free_board(sp.board);
+    free(keys);
+    return true;
 }
 
+// --- Negamax principal variation search ---
+// The first move gets the full window; the rest are searched with a null window around alpha,
+// and only searched again with the full window if they unexpectedly beat it.
+int negamax(SearchThread *t, int depth, int alpha, int beta, int ply, Move prev) {
+    Board *board = t->board;
+    t->pv_length[ply] = 0;
 
-// --- Minimax with alpha-beta pruning and proper history handling ---
-int minimax(Board *board, int depth, bool maximizing, int alpha, int beta,
-            uint64_t path[], int path_len) {
+    if (should_abort(t, ply))
+        return 0;
 
-    GameState state = chess_get_game_state(board);
-    if (depth == 0 || state != GAME_NORMAL)
-        return evaluate_board(board, path, path_len);
+    // dead draws need no search
+    if (chess_is_draw_fast(board) || is_repetition(&t->keys, chess_get_half_moves(board), ply))
+        return 0;
+
+    if (depth == 0)
+        return quiescence(t, alpha, beta, ply);
+
+    bool pv_node = beta - alpha > 1;
+
+    // --- Transposition table cutoff ---
+    // not at PV nodes, where a cutoff would leave the reported line ending here; the hash move still orders them
+    uint64_t key = chess_zobrist_key(board);
+    TTData tt = {0};
+    if (tt_probe(key, &tt) && !pv_node && tt.depth >= depth) {
+        int tt_score = score_from_tt(tt.score, ply);
+        if (tt.bound == BOUND_EXACT) return tt_score;
+        if (tt.bound == BOUND_LOWER && tt_score >= beta) return tt_score;
+        if (tt.bound == BOUND_UPPER && tt_score <= alpha) return tt_score;
+    }
 
     int len;
     Move *moves = chess_get_legal_moves(board, &len);
+    bool in_check = chess_in_check(board);
     if (len == 0) {
         chess_free_moves_array(moves);
-        return evaluate_board(board, path, path_len);
+        return in_check ? -(MATE - ply) : 0;
+    }
+    if (ply >= MAX_PLY) {
+        chess_free_moves_array(moves);
+        return evaluate_relative(board);
     }
 
-    int best_score = maximizing ? INT_MIN : INT_MAX;
+    int static_eval = in_check ? -INF : evaluate_relative(board);
 
-    for (int i = 0; i < len; i++) {
-        // Temporarily make move
-        chess_make_move(board, moves[i]);
-        uint64_t hash = chess_zobrist_key(board);
-
-        // Check repetition along **this search path**
-        int count = 0;
-        for (int j = 0; j < path_len; j++)
-            if (path[j] == hash)
-                count++;
-        if (count >= 2) { // 3rd occurrence = illegal
-            chess_undo_move(board);
+    // --- Reverse futility pruning: far enough above beta that a shallow search won't bring it back ---
+    if (use_futility && !pv_node && !in_check && depth <= RFP_MAX_DEPTH
+        && static_eval - RFP_MARGIN * depth >= beta && static_eval < MATE_BOUND) {
+        chess_free_moves_array(moves);
+        return static_eval;
+    }
+
+    // --- Null move pruning: if passing still beats beta, a real move almost certainly will ---
+    if (use_null_move && !pv_node && !in_check && depth >= NMP_MIN_DEPTH && prev.from
+        && static_eval >= beta && has_non_pawn_material(board)) {
+        int reduction = 3 + depth / 4 + ((static_eval - beta) / 200 < 2 ? (static_eval - beta) / 200 : 2);
+        int null_depth = depth - 1 - reduction > 0 ? depth - 1 - reduction : 0;
+        chess_skip_turn(board);
+        keys_push(&t->keys, chess_zobrist_key(board));
+        int score = -negamax(t, null_depth, -beta, -beta + 1, ply + 1, (Move){0});
+        keys_pop(&t->keys);
+        chess_undo_move(board);
+        if (stopped(t)) {
+            chess_free_moves_array(moves);
+            return 0;
+        }
+        if (score >= beta) {
+            chess_free_moves_array(moves);
+            // don't trust a mate found after passing
+            return score >= MATE_BOUND ? beta : score;
+        }
+    }
+
+    MovePicker picker;
+    picker_init(t, &picker, moves, len, tt.move, ply, prev);
+
+    NodeInfo node = {
+        .depth = depth, .ply = ply, .beta = beta, .pv_node = pv_node, .in_check = in_check,
+        .static_eval = static_eval,
+    };
+    int alpha_orig = alpha;
+    int best_score = -INF;
+    Move best_move = {0};
+    Move move;
+    int searched = 0;
+    int quiets_searched = 0;
+
+    while (picker_next(&picker, &move)) {
+        int score = search_move(t, &node, move, searched, quiets_searched, alpha, best_score);
+        if (score == MOVE_SKIPPED)
             continue;
+        searched++;
+        if (!move.capture && !move.promotion) quiets_searched++;
+
+        if (stopped(t)) {
+            chess_free_moves_array(moves);
+            return 0;
+        }
+
+        if (score > best_score) {
+            best_score = score;
+            best_move = move;
+        }
+        if (score > alpha) {
+            alpha = score;
+            update_pv(t, ply, move);
+        }
+        if (alpha >= beta) {
+            record_cutoff(t, searched);
+            if (!move.capture && !move.promotion)
+                update_quiet_cutoff(t, move, depth, ply, prev);
+            break;
+        }
+
+        // the eldest brother is done and didn't cut off, so the young brothers may be searched in parallel
+        if (use_ybwc && active_threads > 1 && depth >= YBWC_MIN_DEPTH
+            && split(t, &picker, &node, prev, &alpha, &best_score, &best_move, &searched, quiets_searched)) {
+            if (stopped(t)) {
+                chess_free_moves_array(moves);
+                return 0;
+            }
+            break;
         }
+    }
+
+    chess_free_moves_array(moves);
+
+    int bound = best_score <= alpha_orig ? BOUND_UPPER : best_score >= beta ? BOUND_LOWER : BOUND_EXACT;
+    tt_store(key, depth, bound, score_to_tt(best_score, ply), best_move);
+    return best_score;
+}
+
+
+// the opponent's last move, for the countermove ordering at the root; fetched once per search
+static Move root_prev = {0};
+
+// --- Search the root to a fixed depth within a window ---
+// Returns false if the search was aborted, in which case [best_move] and [best_score] are left alone.
+// Only a search of every root move should [store] its result, since the table has one entry for the root.
+bool search_root(SearchThread *t, Move *moves, int len, int depth, int alpha, int beta, bool store,
+                 Move *best_move, int *best_score) {
+    Board *board = t->board;
+    TTData tt = {0};
+    tt_probe(chess_zobrist_key(board), &tt);
+    MovePicker picker;
+    picker_init(t, &picker, moves, len, tt.move, 0, root_prev);
+
+    int alpha_orig = alpha;
+    Move best = moves[0];
+    int best_value = -INF;
+    int searched = 0;
+    t->pv_length[0] = 0;
+
+    Move move;
+    while (picker_next(&picker, &move)) {
+        // Make move temporarily
+        chess_make_move(board, move);
+        keys_push(&t->keys, chess_zobrist_key(board));
 
-        // Append hash to path for recursion
-        path[path_len] = hash;
-        int score = minimax(board, depth - 1, !maximizing, alpha, beta, path, path_len + 1);
+        int score;
+        if (searched == 0) {
+            score = -negamax(t, depth - 1, -beta, -alpha, 1, move);
+        } else {
+            score = -negamax(t, depth - 1, -alpha - 1, -alpha, 1, move);
+            if (score > alpha && score < beta)
+                score = -negamax(t, depth - 1, -beta, -alpha, 1, move);
+        }
+        searched++;
 
+        keys_pop(&t->keys);
         chess_undo_move(board);
 
-        if (maximizing) {
-            if (score > best_score) best_score = score;
-            if (score > alpha) alpha = score;
+        if (aborted())
+            return false;
+
+        if (score > best_value) {
+            best_value = score;
+            best = move;
+        }
+        if (score > alpha) {
+            alpha = score;
+            update_pv(t, 0, move);
+        }
+        if (alpha >= beta)
+            break;
+    }
+
+    if (store && searched > 0) {
+        int bound = best_value <= alpha_orig ? BOUND_UPPER : best_value >= beta ? BOUND_LOWER : BOUND_EXACT;
+        tt_store(chess_zobrist_key(board), depth, bound, best_value, best);
+    }
+    *best_move = best;
+    *best_score = best_value;
+    return true;
+}
+
+// --- Aspiration windows ---
+// From ASPIRATION_MIN_DEPTH on, the search starts with a narrow window around [guess], the score the previous
+// iteration found, and widens it on failure. Returns false if the search was aborted.
+bool aspiration_search(SearchThread *t, Move *moves, int len, int depth, int guess, bool store, Move *best_move, int *best_score) {
+    int delta = ASPIRATION_WINDOW;
+    int alpha = -INF, beta = INF;
+    if (depth >= ASPIRATION_MIN_DEPTH && guess > -MATE_BOUND && guess < MATE_BOUND) {
+        alpha = guess - delta;
+        beta = guess + delta;
+    }
+
+    while (search_root(t, moves, len, depth, alpha, beta, store, best_move, best_score)) {
+        if (*best_score <= alpha && alpha > -INF) {
+            alpha = (*best_score - delta > -INF) ? *best_score - delta : -INF;
+        } else if (*best_score >= beta && beta < INF) {
+            beta = (*best_score + delta < INF) ? *best_score + delta : INF;
         } else {
-            if (score < best_score) best_score = score;
-            if (score < beta) beta = score;
+            return true;
+        }
+        delta *= 2;
+    }
+    return false;
+}
+
+// --- MultiPV ---
+// With the MultiPV option above 1 the main thread searches each iteration once per line, every time leaving out
+// the moves of the lines already found. The later passes mostly hit the table entries the earlier ones left.
+#define MAX_MULTIPV 64
+
+static int multi_pv = 1;
+
+// --- Search info ---
+// The main thread reports each iteration, but no more often than INFO_INTERVAL_MS, so the fast early iterations
+// don't flood the GUI; the last completed iteration is always reported when the search ends.
+// In MultiPV mode every line is reported, since each one is an expensive search of its own.
+#define INFO_INTERVAL_MS 100
+
+static uint64_t last_info_millis = 0;
+static int reported_depth = 0;
+
+void send_info(int depth, int multipv, int score, const Move *pv, int pv_length) {
+    SearchInfo info = {0};
+    info.depth = depth;
+    info.multipv = multipv;
+    for (int i = 0; i < active_threads; i++) {
+        info.nodes += atomic_load_explicit(&search_threads[i].nodes, memory_order_relaxed);
+        int seldepth = atomic_load_explicit(&search_threads[i].seldepth, memory_order_relaxed);
+        if (seldepth > info.seldepth) info.seldepth = seldepth;
+    }
+    if (score >= MATE_BOUND || score <= -MATE_BOUND) {
+        info.mate = true;
+        info.score = score > 0 ? (MATE - score + 1) / 2 : -(MATE + score) / 2;
+    } else {
+        info.score = score;
+    }
+    info.time_millis = chess_get_elapsed_time_millis();
+    info.hashfull = tt_hashfull();
+    info.pv = pv;
+    info.pv_length = pv_length;
+    chess_send_info(&info);
+    last_info_millis = info.time_millis;
+    reported_depth = depth;
+}
+
+// --- Iterative deepening ---
+// The main thread pushes its best move after every completed iteration, so an abort always leaves a searched move in place,
+// and decides when to stop; helpers keep deepening until it does.
+void iterative_deepening(SearchThread *t, Move *moves, int len) {
+    int stable_iterations = 0;
+    // the lines found so far are kept at the front of [moves], in order
+    int lines = t->id == 0 ? multi_pv : 1;
+    if (lines > len) lines = len;
+    int line_scores[MAX_MULTIPV] = {0};
+
+    // helpers on odd ids start a ply deeper, so the threads spread over two depths instead of racing on one
+    for (int depth = 1 + (t->id & 1); depth <= depth_limit && !aborted(); depth++) {
+        for (int k = 0; k < lines; k++) {
+            Move line_best;
+            int line_score;
+            if (!aspiration_search(t, moves + k, len - k, depth, line_scores[k], k == 0, &line_best, &line_score))
+                break;
+            for (int i = k; i < len; i++) {
+                if (!same_move(moves[i], line_best)) continue;
+                moves[i] = moves[k];
+                moves[k] = line_best;
+                break;
+            }
+            line_scores[k] = line_score;
+            if (lines > 1)
+                send_info(depth, k + 1, line_score, t->pv[0], t->pv_length[0]);
+
+            // the first line searched every move, so it alone decides the best move
+            if (k > 0)
+                continue;
+            stable_iterations = (t->completed_depth > 0 && same_move(line_best, t->best_move)) ? stable_iterations + 1 : 0;
+            t->completed_depth = depth;
+            t->best_move = line_best;
+            t->best_score = line_score;
+            memcpy(t->best_pv, t->pv[0], t->pv_length[0] * sizeof(Move));
+            t->best_pv_length = t->pv_length[0];
         }
+        if (aborted() || t->completed_depth < depth)
+            break;
+
+        // node limited searches report every iteration, so their output doesn't depend on timing
+        if (t->id == 0 && !benching && lines == 1 && (node_limit > 0 || chess_get_elapsed_time_millis() >= last_info_millis + INFO_INTERVAL_MS))
+            send_info(depth, 0, t->best_score, t->best_pv, t->best_pv_length);
+
+        // a forced mate won't get any better by searching deeper, unless there are other lines to fill in
+        if (lines == 1 && (t->best_score >= MATE_BOUND || t->best_score <= -MATE_BOUND))
+            break;
+
+        if (t->id != 0 || benching)
+            continue;
+        chess_push(t->best_move);
 
-        if (beta <= alpha)
+        // the next iteration usually costs more than all the previous ones together, so past half the
+        // soft budget it likely won't finish; a best move that has held for several iterations stops sooner
+        uint64_t target = stable_iterations >= 4 ? soft_deadline / 4 : soft_deadline / 2;
+        if (chess_get_elapsed_time_millis() >= target)
             break;
     }
+}
 
-    chess_free_moves_array(moves);
-    return best_score;
+// --- Parallel search ---
+// Lazy SMP by default: helper threads run the same iterative deepening on their own boards, and help the main thread
+// only through the entries they leave in the shared transposition table. --parallel ybwc splits the tree instead.
+typedef struct {
+    SearchThread *thread;
+    Move *moves;
+    int len;
+} HelperJob;
+
+int helper_main(void *arg) {
+    HelperJob *job = (HelperJob *)arg;
+    iterative_deepening(job->thread, job->moves, job->len);
+    return 0;
+}
+
+// In the work-stealing mode only the main thread runs iterative deepening; the others search whatever
+// moves they can steal from it, and from each other, until it is done.
+int worker_main(void *arg) {
+    SearchThread *t = (SearchThread *)arg;
+    while (!aborted()) {
+        Task task;
+        if (steal_task(t, &task))
+            run_task(t, &task, false);
+        else
+            thrd_yield();
+    }
+    return 0;
 }
 
+void threads_init(int count) {
+    if (count < 1) count = 1;
+    if (count > MAX_THREADS) count = MAX_THREADS;
+    for (int i = 0; i < thread_count; i++) {
+        mtx_destroy(&search_threads[i].deque->lock);
+        free(search_threads[i].deque);
+    }
+    free(search_threads);
+    search_threads = calloc(count, sizeof(SearchThread));
+    thread_count = count;
+    for (int i = 0; i < count; i++) {
+        search_threads[i].id = i;
+        search_threads[i].deque = calloc(1, sizeof(TaskDeque));
+        mtx_init(&search_threads[i].deque->lock, mtx_plain);
+    }
+}
 
-// --- Find best move avoiding repetition ---
-Move find_best_move(Board *board, int depth, uint64_t history[], int history_len) {
+// The reply we expect to [move]: the hash move of the position after it, if it is legal there
+Move expected_reply(Board *board, Move move) {
+    Move reply = {0};
+    chess_make_move(board, move);
+    TTData tt;
+    if (tt_probe(chess_zobrist_key(board), &tt) && tt.move.from) {
+        int len;
+        Move *moves = chess_get_legal_moves(board, &len);
+        for (int i = 0; i < len; i++)
+            if (same_move(moves[i], tt.move))
+                reply = moves[i];
+        chess_free_moves_array(moves);
+    }
+    chess_undo_move(board);
+    return reply;
+}
+
+// Readies [t] to search [board], whose earlier positions since the last irreversible move are [game_keys]
+void thread_new_search(SearchThread *t, Board *board, Move first, const uint64_t *game_keys, int game_len) {
+    ordering_new_search(t);
+    t->nodes = 0;
+    t->seldepth = 0;
+    t->best_pv_length = 0;
+    t->completed_depth = 0;
+    t->best_move = first;
+    t->best_score = -INF;
+    t->split = NULL;
+    t->keys.len = 0;
+    keys_reserve(&t->keys, game_len + MAX_PLY + 2);
+    for (int k = 0; k < game_len; k++)
+        keys_push(&t->keys, game_keys[k]);
+    keys_push(&t->keys, chess_zobrist_key(board));
+}
+
+// Keeps only the root moves the GUI named with "go searchmoves", unless it named none that are legal
+int keep_search_moves(Move *moves, int len) {
+    Move wanted[MAX_MOVES];
+    int count = chess_get_search_moves(wanted, MAX_MOVES);
+    int kept = 0;
+    for (int i = 0; i < len; i++) {
+        for (int j = 0; j < count; j++) {
+            if (!same_move(moves[i], wanted[j])) continue;
+            moves[kept++] = moves[i];
+            break;
+        }
+    }
+    return kept > 0 ? kept : len;
+}
+
+// --- Search the position within the time budget ---
+Move find_best_move(Board *board) {
+    chess_get_search_limits(&limits);
+    clock_given = chess_is_white_turn(board) ? limits.wtime_given : limits.btime_given;
+    // the GUI may have resized the table since the last search; that empties it
+    size_t hash_mb = (size_t)chess_get_option("Hash");
+    if (hash_mb != tt_megabytes)
+        tt_init(hash_mb);
     int len;
     Move *moves = chess_get_legal_moves(board, &len);
+    len = keep_search_moves(moves, len);
 
     if (len == 0) {
         chess_free_moves_array(moves);
-        return (Move){0}; // no moves
+        chess_push((Move){0}); // no moves, so the GUI gets the null move
+        return (Move){0};
     }
 
     Move best_move = moves[0];
-    bool maximizing = chess_is_white_turn(board);
-    int best_score = maximizing ? INT_MIN : INT_MAX;
+    chess_push(best_move);
+    if (len == 1) {
+        chess_free_moves_array(moves);
+        return best_move;
+    }
 
-    // Temporary array for search path
-    uint64_t path[1024];
+    depth_limit = limits.depth > 0 && limits.depth < fixed_depth ? limits.depth : fixed_depth;
+    // a mate in n takes 2n - 1 plies; two more make up for the reductions along the way
+    if (limits.mate > 0 && 2 * limits.mate + 1 < depth_limit)
+        depth_limit = 2 * limits.mate + 1;
+    node_limit = limits.nodes;
+    // a node limited search must give the same result every time, so it starts from nothing and uses one thread
+    active_threads = node_limit > 0 ? 1 : thread_count;
+    if (node_limit > 0) {
+        tt_clear();
+        ordering_clear(&search_threads[0]);
+    }
 
-    // Copy current history into path
-    memcpy(path, history, history_len * sizeof(uint64_t));
-    int path_len = history_len;
+    plan_time();
+    tt_new_search();
+    multi_pv = chess_get_option("MultiPV");
+    root_prev = chess_get_opponent_move();
+    last_info_millis = 0;
+    reported_depth = 0;
+    atomic_store(&search_aborted, false);
 
-    for (int i = 0; i < len; i++) {
-        // Skip moves that would cause repetition
-        if (would_repeat(board, moves[i], history, history_len))
+    // only positions since the last irreversible move can repeat
+    int halfmoves = chess_get_half_moves(board);
+    uint64_t *game_keys = malloc((halfmoves + 1) * sizeof(uint64_t));
+    int game_len = chess_get_history_keys(board, game_keys, halfmoves);
+
+    thrd_t handles[MAX_THREADS];
+    HelperJob jobs[MAX_THREADS];
+    for (int i = 0; i < active_threads; i++) {
+        SearchThread *t = &search_threads[i];
+        thread_new_search(t, board, moves[0], game_keys, game_len);
+        if (i == 0) {
+            t->board = board;
+            continue;
+        }
+        if (use_ybwc) {
+            // workers only ever search clones of the split positions they steal
+            t->board = NULL;
+            thrd_create(&handles[i], worker_main, t);
             continue;
+        }
+        // boards share their move history by reference count, which isn't thread safe, so helpers get detached copies
+        t->board = chess_clone_board_detached(board);
+        jobs[i].thread = t;
+        jobs[i].moves = malloc(len * sizeof(Move));
+        memcpy(jobs[i].moves, moves, len * sizeof(Move));
+        jobs[i].len = len;
+        thrd_create(&handles[i], helper_main, &jobs[i]);
+    }
 
-        // Make move temporarily
-        chess_make_move(board, moves[i]);
-        uint64_t hash = chess_zobrist_key(board);
+    free(game_keys);
 
-        // Add to path for recursion
-        path[path_len] = hash;
-        int score = minimax(board, depth - 1, !maximizing, INT_MIN, INT_MAX, path, path_len + 1);
+    iterative_deepening(&search_threads[0], moves, len);
 
-        chess_undo_move(board);
+    // the main thread has decided to stop, so the helpers should too
+    atomic_store(&search_aborted, true);
+    for (int i = 1; i < active_threads; i++) {
+        thrd_join(handles[i], NULL);
+        if (use_ybwc)
+            continue;
+        free(jobs[i].moves);
+        chess_free_board(search_threads[i].board);
+    }
 
-        if ((maximizing && score > best_score) || (!maximizing && score < best_score)) {
-            best_score = score;
-            best_move = moves[i];
-        }
+    // play the deepest completed result, preferring the main thread's on ties
+    SearchThread *best = &search_threads[0];
+    uint64_t cutoffs = 0, first_move_cutoffs = 0;
+    for (int i = 0; i < active_threads; i++) {
+        SearchThread *t = &search_threads[i];
+        cutoffs += t->cutoffs;
+        first_move_cutoffs += t->first_move_cutoffs;
+        if (t->completed_depth > best->completed_depth)
+            best = t;
     }
+    if (best->completed_depth > 0)
+        best_move = best->best_move;
+    chess_push(best_move);
+    // offered to the GUI, which may have us search the position after it while the opponent thinks
+    Move reply = best->completed_depth > 0 && best->best_pv_length > 1 ? best->best_pv[1] : expected_reply(board, best_move);
+    if (reply.from)
+        chess_push_ponder(reply);
+
+    // the last iteration may have come too soon after the previous report, or a helper may have got deeper
+    if (multi_pv == 1 && best->completed_depth > 0 && (best != &search_threads[0] || reported_depth != best->completed_depth))
+        send_info(best->completed_depth, 0, best->best_score, best->best_pv, best->best_pv_length);
+    char text[128];
+    snprintf(text, sizeof(text), "threads %d (%s), first-move cutoffs %.1f%%", active_threads, use_ybwc ? "ybwc" : "lazy",
+             cutoffs ? 100.0 * first_move_cutoffs / cutoffs : 0.0);
+    chess_send_info_string(text);
 
     chess_free_moves_array(moves);
     return best_move;
 }
 
-int main(void) {
-    uint64_t board_history[1024]; // large enough buffer
-    int history_len = 0;
+// --- Bench ---
+// A fixed set of positions, each searched to a fixed depth on one thread from an empty hash table. The total node count
+// is a signature of the search: a change meant only to make it faster must leave it alone, and the time shows the gain.
+#define BENCH_DEPTH 12
+
+static const char *bench_fens[] = {
+    // openings and middlegames
+    "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1",
+    "r1bqkbnr/pppp1ppp/2n5/4p3/4P3/5N2/PPPP1PPP/RNBQKB1R w KQkq - 2 3",
+    "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 10",
+    "r3k2r/Pppp1ppp/1b3nbN/nP6/BBP1P3/q4N2/Pp1P2PP/R2Q1RK1 w kq - 0 1",
+    "rnbq1k1r/pp1Pbppp/2p5/8/2B5/8/PPP1NnPP/RNBQK2R w KQ - 1 8",
+    "r4rk1/1pp1qppp/p1np1n2/2b1p1B1/2B1P1b1/P1NP1N2/1PP1QPPP/R4RK1 w - - 0 10",
+    "4rrk1/pp1n3p/3q2pQ/2p1pb2/2PP4/2P3N1/P2B2PP/4RRK1 b - - 7 19",
+    "rq3rk1/ppp2ppp/1bnpb3/3N2B1/3NP3/7P/PPPQ1PP1/2KR3R w - - 7 14",
+    "r1bq1r1k/1pp1n1pp/1p1p4/4p2Q/4Pp2/1BNP4/PPP2PPP/3R1RK1 w - - 2 14",
+    "r3r1k1/2p2ppp/p1p1bn2/8/1q2P3/2NPQN2/PPP3PP/R4RK1 b - - 2 15",
+    "r1bbk1nr/pp3p1p/2n5/1N4p1/2Np1B2/8/PPP2PPP/2KR1B1R w kq - 0 13",
+    "r1bq1rk1/ppp1nppp/4n3/3p3Q/3P4/1BP1B3/PP1N2PP/R4RK1 w - - 1 16",
+    "4r1k1/r1q2ppp/ppp2n2/4P3/5Rb1/1N1BQ3/PPP3PP/R5K1 w - - 1 17",
+    "2rqkb1r/ppp2p2/2npb1p1/1N1Nn2p/2P1PP2/8/PP2B1PP/R1BQK2R b KQ - 0 11",
+    "r1bq1r1k/b1p1npp1/p2p3p/1p6/3PP3/1B2NN2/PP3PPP/R2Q1RK1 w - - 1 16",
+    "3r1rk1/p5pp/bpp1pp2/8/q1PP1P2/b3P3/P2NQRPP/1R2B1K1 b - - 6 22",
+    "r1q2rk1/2p1bppp/2Pp4/p6b/Q1PNp3/4B3/PP1R1PPP/2K4R w - - 2 18",
+    "4k2r/1pb2ppp/1p2p3/1R1p4/3P4/2r1PN2/P4PPP/1R4K1 b - - 3 22",
+    "3q2k1/pb3p1p/4pbp1/2r5/PpN2N2/1P2P2P/5PP1/Q2R2K1 b - - 4 26",
+    "r3k2r/3nnpbp/q2pp1p1/p7/Pp1PPPP1/4BNN1/1P5P/R2Q1RK1 w kq - 0 16",
+    "4rrk1/1p1nq3/p7/2p1P1pp/3P2bp/3Q1Bn1/PPPB4/1K2R1NR w - - 40 21",
+    "3Qb1k1/1r2ppb1/pN1n2q1/Pp1Pp1Pr/4P2p/4BP2/4B1R1/1R5K b - - 11 40",
+    "4k3/3q1r2/1N2r1b1/3ppN2/2nPP3/1B1R2n1/2R1Q3/3K4 w - - 5 1",
+    "5rk1/q6p/2p3bR/1pPp1rP1/1P1Pp3/P3B1Q1/1K3P2/R7 w - - 93 90",
+    "6k1/3b3r/1p1p4/p1n2p2/1PPNpP1q/P3Q1p1/1R1RB1P1/5K2 b - - 0 1",
+    "r2r1n2/pp2bk2/2p1p2p/3q4/3PN1QP/2P3R1/P4PP1/5RK1 w - - 0 1",
+    "1r3k2/4q3/2Pp3b/3Bp3/2Q2p2/1p1P2P1/1P2KP2/3N4 w - - 0 1",
+    "6k1/6p1/P6p/r1N5/5p2/7P/1b3PP1/4R1K1 w - - 0 1",
+    "6k1/4pp1p/3p2p1/P1pPb3/R7/1r2P1PP/3B1P2/6K1 w - - 0 1",
+    // endgames
+    "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 11",
+    "6k1/6p1/6Pp/ppp5/3pn2P/1P3K2/1PP2P2/3N4 b - - 0 1",
+    "3b4/5kp1/1p1p1p1p/pP1PpP1P/P1P1P3/3KN3/8/8 w - - 0 1",
+    "2K5/p7/7P/5pR1/8/5k2/r7/8 w - - 0 1",
+    "8/6pk/1p6/8/PP3p1p/5P2/4KP1q/3Q4 w - - 0 1",
+    "7k/3p2pp/4q3/8/4Q3/5Kp1/P6b/8 w - - 0 1",
+    "8/2p5/8/2kPKp1p/2p4P/2P5/3P4/8 w - - 0 1",
+    "8/1p3pp1/7p/5P1P/2k3P1/8/2K2P2/8 w - - 0 1",
+    "8/pp2r1k1/2p1p3/3pP2p/1P1P1P1P/P5KR/8/8 w - - 0 1",
+    "8/3p4/p1bk3p/Pp6/1Kp1PpPp/2P2P1P/2P5/5B2 b - - 0 1",
+    "5k2/7R/4P2p/5K2/p1r2P1p/8/8/8 b - - 0 1",
+    "8/3p3B/5p2/5P2/p7/PP5b/k7/6K1 w - - 0 1",
+    "8/8/8/8/5kp1/P7/8/1K1N4 w - - 0 1",
+    "8/8/8/5N2/8/p7/8/2NK3k w - - 0 1",
+    "8/3k4/8/8/8/4B3/4KN2/8 w - - 0 1",
+    "8/8/1P6/5pr1/8/4R3/7k/2K5 w - - 0 1",
+    "8/2p4P/8/kr6/6R1/8/8/1K6 w - - 0 1",
+    "8/8/3P3k/8/1p6/8/1P6/1K3n2 b - - 0 1",
+    "8/R7/2q5/8/6k1/8/1P5p/K6R w - - 0 124",
+    "8/8/8/8/8/6k1/6p1/4K3 w - - 0 1",
+    "8/8/8/4k3/8/8/8/3QK3 w - - 0 1",
+};
+#define BENCH_POSITIONS ((int)(sizeof(bench_fens) / sizeof(bench_fens[0])))
+
+uint64_t wall_clock_millis(void) {
+    struct timespec now;
+    timespec_get(&now, TIME_UTC);
+    return (uint64_t)now.tv_sec * 1000 + now.tv_nsec / 1000000;
+}
+
+// Writes a line of bench output straight to stdout, for a bench run from the command line without the chess server
+void print_line(const char *text) {
+    printf("%s\n", text);
+    fflush(stdout);
+}
+
+// Searches every bench position to [depth] and reports the totals through [print], as JSON if [json]
+void bench(int depth, bool json, void (*print)(const char *text)) {
+    if (depth < 1 || depth > MAX_DEPTH) depth = BENCH_DEPTH;
+    benching = true;
+    depth_limit = depth;
+    node_limit = 0;
+    active_threads = 1;
+    multi_pv = 1;
+    pondering = false;
+    soft_deadline = hard_deadline = UINT64_MAX;
+    root_prev = (Move){0};
+
+    SearchThread *t = &search_threads[0];
+    uint64_t total_nodes = 0;
+    uint64_t start = wall_clock_millis();
+    for (int i = 0; i < BENCH_POSITIONS; i++) {
+        Board *board = chess_board_from_fen(bench_fens[i]);
+        int len;
+        Move *moves = chess_get_legal_moves(board, &len);
+        // every position starts from nothing, so the signature doesn't depend on the order they run in
+        tt_clear();
+        tt_new_search();
+        ordering_clear(t);
+        thread_new_search(t, board, moves[0], NULL, 0);
+        t->board = board;
+        atomic_store(&search_aborted, false);
+        iterative_deepening(t, moves, len);
+        total_nodes += t->nodes;
+        if (!json) {
+            char move[8], text[192];
+            chess_move_to_uci(t->best_move, move);
+            snprintf(text, sizeof(text), "position %d/%d nodes %llu bestmove %s fen %s", i + 1, BENCH_POSITIONS,
+                     (unsigned long long)t->nodes, move, bench_fens[i]);
+            print(text);
+        }
+        chess_free_moves_array(moves);
+        chess_free_board(board);
+    }
+    uint64_t elapsed = wall_clock_millis() - start;
+    uint64_t nps = total_nodes * 1000 / (elapsed ? elapsed : 1);
+    // the table holds nothing useful for a game now, and a search that follows should start clean
+    tt_clear();
+    ordering_clear(t);
+    benching = false;
+
+    char text[160];
+    if (json)
+        snprintf(text, sizeof(text), "{\"depth\": %d, \"positions\": %d, \"nodes\": %llu, \"time_ms\": %llu, \"nps\": %llu}",
+                 depth, BENCH_POSITIONS, (unsigned long long)total_nodes, (unsigned long long)elapsed, (unsigned long long)nps);
+    else
+        snprintf(text, sizeof(text), "depth %d positions %d nodes %llu time %llu ms nps %llu", depth, BENCH_POSITIONS,
+                 (unsigned long long)total_nodes, (unsigned long long)elapsed, (unsigned long long)nps);
+    print(text);
+}
+
+// "bench [depth] [json]", from the UCI console. The API only calls this between searches, and the output goes
+// out as info strings, under the same lock as the rest of the UCI output
+void bench_hook(const char *args, void *context) {
+    (void)context;
+    int depth = BENCH_DEPTH;
+    bool json = false;
+    char word[32];
+    int used;
+    while (sscanf(args, "%31s%n", word, &used) == 1) {
+        if (!strcmp(word, "json")) json = true;
+        else depth = atoi(word);
+        args += used;
+    }
+    bench(depth, json, chess_send_info_string);
+}
+
+int main(int argc, char **argv) {
+    // switches for A/B testing the search
+    int threads = 1;
+    int hash_mb = TT_DEFAULT_MB;
+    // "bench [depth] [json]" runs the benchmark and exits, without starting the chess server
+    bool run_bench = false, bench_json = false;
+    int bench_depth = BENCH_DEPTH;
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "bench")) {
+            run_bench = true;
+            if (i + 1 < argc && argv[i + 1][0] >= '0' && argv[i + 1][0] <= '9') bench_depth = atoi(argv[++i]);
+            if (i + 1 < argc && !strcmp(argv[i + 1], "json")) bench_json = true, i++;
+        }
+        else if (!strcmp(argv[i], "--no-nmp")) use_null_move = false;
+        else if (!strcmp(argv[i], "--no-lmr")) use_lmr = false;
+        else if (!strcmp(argv[i], "--no-futility")) use_futility = false;
+        else if (!strcmp(argv[i], "--no-lmp")) use_lmp = false;
+        else if (!strcmp(argv[i], "--no-see")) qsearch_see = false;
+        else if (!strcmp(argv[i], "--threads") && i + 1 < argc) threads = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "--parallel") && i + 1 < argc) use_ybwc = !strcmp(argv[++i], "ybwc");
+        else if (!strcmp(argv[i], "--depth") && i + 1 < argc) fixed_depth = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "--hash") && i + 1 < argc) hash_mb = atoi(argv[++i]);
+    }
+    if (hash_mb < 1 || hash_mb > TT_MAX_MB) hash_mb = TT_DEFAULT_MB;
+    if (fixed_depth < 1 || fixed_depth > MAX_DEPTH) fixed_depth = MAX_DEPTH;
+    // splitting only costs time without threads to take the work
+    if (threads < 2) use_ybwc = false;
+    init_lmr_table();
+    threads_init(threads);
+    chess_add_spin_option("MultiPV", 1, 1, MAX_MULTIPV);
+    // --hash sets the size until the GUI picks another
+    chess_add_spin_option("Hash", hash_mb, 1, TT_MAX_MB);
+
+    tt_init(hash_mb);
+    chess_set_prefetch_hook(tt_prefetch, NULL);
+    if (run_bench) {
+        bench(bench_depth, bench_json, print_line);
+        return 0;
+    }
+    chess_set_bench_hook(bench_hook, NULL);
 
     for (int i = 0; i < 500; i++) {
         Board *board = chess_get_board();
-        if (chess_get_game_state(board) != GAME_NORMAL) {
+        // a ponder search on a finished game still has to wait for the GUI
+        if (chess_get_game_state(board) != GAME_NORMAL && !chess_is_pondering()) {
             chess_free_board(board);
             break;
         }
 
-        Move best = find_best_move(board, 5, board_history, history_len); // depth 5 safe
-
-        chess_push(best);
-        board_history[history_len++] = chess_zobrist_key(board);
+        find_best_move(board);
+        wait_for_gui();
 
         chess_done();
         chess_free_board(board);
@@ -1,3 +1,6 @@
+#ifndef _WIN32
+#define _POSIX_C_SOURCE 200809L  // clock_gettime() and CLOCK_MONOTONIC, even when compiling without GNU extensions
+#endif
 #include "chessapi.h"
 #include <stdlib.h>
 #include <string.h>
@@ -5,12 +8,17 @@
 #include <stdbool.h>
 #include <stdint.h>
 #include <time.h>
+#include <ctype.h>
+#include <stdatomic.h>
 
 #define CHESS_BOT_NAME "My Chess Bot"
 #define BOT_AUTHOR_NAME "Author Name Here"
+// more than the legal moves in any position, so "go searchmoves" never has to drop one
+#define MAX_SEARCH_MOVES 256
 
 #ifdef _WIN32
 #include "tinycthread.h"  // Windows: tinycthread provides C11 threads
+#include <windows.h>      // QueryPerformanceCounter, for the monotonic clock
 #else
 #include <threads.h>      // Unix/Linux: use native C11 threads
 #endif
@@ -64,11 +72,20 @@ typedef struct {
     // pthread_t uci_thread;
     thrd_t uci_thread;
     Board *shared_board;
-    uint64_t wtime;
-    uint64_t btime;
-    clock_t turn_started_time;
+    SearchLimits limits;        // from the latest "go"
+    Move search_moves[MAX_SEARCH_MOVES];  // from "go searchmoves"
+    int search_move_count;
+    // the search polls the fields below without the mutex, so they are atomics; the UCI thread still
+    // writes them under the mutex, to keep them in step with the rest
+    _Atomic uint64_t turn_started_millis;   // monotonic_millis() when the clock started for this turn
+    _Atomic uint64_t time_millis;           // the side to move's clock at "go"
+    _Atomic uint64_t opponent_time_millis;
+    atomic_uint_least32_t latest_opponent_move;   // as packed by pack_move()
+    atomic_bool pondering;      // searching after "go ponder", until "ponderhit" or "stop"
     Move latest_pushed_move;
-    Move latest_opponent_move;
+    Move ponder_move;           // the reply the bot expects to latest_pushed_move, or zero for none
+    bool searching;             // from "go" until the bot calls chess_done()
+    atomic_bool stop_requested; // set by "stop", cleared by the next "go"; read without the mutex so it can be polled often
     // pthread_mutex_t mutex;
     mtx_t mutex;
     // sem_t intermission_mutex;
@@ -103,10 +120,104 @@ struct Board {
     int halfmoves;
     int fullmoves;
     uint64_t hash;
+    int psqt_mg;  // white-minus-black material + piece-square score, middlegame weights
+    int psqt_eg;  // same, endgame weights
+    int phase;    // remaining non-pawn material, 0 (bare kings) to PSQT_MAX_PHASE (all pieces)
 };
 
 static InternalAPI *API = NULL;
 static uint64_t zobrist_keys[781];
+// offset into zobrist_keys for each piece, indexed by [color * 6 + piece type - 1] like the piece-square tables
+static const int zobrist_piece_offset[12] = {64*6, 64*8, 64*11, 64*7, 64*9, 64*10, 64*0, 64*2, 64*5, 64*1, 64*3, 64*4};
+static void (*prefetch_hook)(uint64_t key, void *context) = NULL;
+static void *prefetch_context = NULL;
+static void (*bench_hook)(const char *args, void *context) = NULL;
+static void *bench_context = NULL;
+
+// UCI options the bot has declared; values are set by the GUI under API->mutex
+#define MAX_OPTIONS 32
+#define MAX_OPTION_NAME 64
+
+typedef struct {
+    char name[MAX_OPTION_NAME];
+    int value;
+    int default_value;
+    int min;
+    int max;
+} SpinOption;
+
+static SpinOption options[MAX_OPTIONS];
+static int option_count = 0;
+
+// piece-square tables, indexed by [color * 6 + piece type - 1][square]; black entries are mirrored and negated
+#define PSQT_MAX_PHASE 24
+static int psqt_mg[12][64];
+static int psqt_eg[12][64];
+static bool psqt_loaded = false;
+static once_flag psqt_once = ONCE_FLAG_INIT;
+static const int psqt_phase_weights[6] = {0, 1, 1, 2, 4, 0};
+
+// Default tables. Material values match those used by the example bots.
+// The positional tables are laid out as seen from white's side, i.e. rank 8 first, and flipped on load.
+static const int default_psqt_material[6] = {100, 330, 320, 500, 900, 0};
+static const int default_psqt_positional[7][64] = {
+    {  0,  0,  0,  0,  0,  0,  0,  0,   // pawn
+      50, 50, 50, 50, 50, 50, 50, 50,
+      10, 10, 20, 30, 30, 20, 10, 10,
+       5,  5, 10, 25, 25, 10,  5,  5,
+       0,  0,  0, 20, 20,  0,  0,  0,
+       5, -5,-10,  0,  0,-10, -5,  5,
+       5, 10, 10,-20,-20, 10, 10,  5,
+       0,  0,  0,  0,  0,  0,  0,  0},
+    {-20,-10,-10,-10,-10,-10,-10,-20,   // bishop
+     -10,  0,  0,  0,  0,  0,  0,-10,
+     -10,  0,  5, 10, 10,  5,  0,-10,
+     -10,  5,  5, 10, 10,  5,  5,-10,
+     -10,  0, 10, 10, 10, 10,  0,-10,
+     -10, 10, 10, 10, 10, 10, 10,-10,
+     -10,  5,  0,  0,  0,  0,  5,-10,
+     -20,-10,-10,-10,-10,-10,-10,-20},
+    {-50,-40,-30,-30,-30,-30,-40,-50,   // knight
+     -40,-20,  0,  0,  0,  0,-20,-40,
+     -30,  0, 10, 15, 15, 10,  0,-30,
+     -30,  5, 15, 20, 20, 15,  5,-30,
+     -30,  0, 15, 20, 20, 15,  0,-30,
+     -30,  5, 10, 15, 15, 10,  5,-30,
+     -40,-20,  0,  5,  5,  0,-20,-40,
+     -50,-40,-30,-30,-30,-30,-40,-50},
+    {  0,  0,  0,  0,  0,  0,  0,  0,   // rook
+       5, 10, 10, 10, 10, 10, 10,  5,
+      -5,  0,  0,  0,  0,  0,  0, -5,
+      -5,  0,  0,  0,  0,  0,  0, -5,
+      -5,  0,  0,  0,  0,  0,  0, -5,
+      -5,  0,  0,  0,  0,  0,  0, -5,
+      -5,  0,  0,  0,  0,  0,  0, -5,
+       0,  0,  0,  5,  5,  0,  0,  0},
+    {-20,-10,-10, -5, -5,-10,-10,-20,   // queen
+     -10,  0,  0,  0,  0,  0,  0,-10,
+     -10,  0,  5,  5,  5,  5,  0,-10,
+      -5,  0,  5,  5,  5,  5,  0, -5,
+       0,  0,  5,  5,  5,  5,  0, -5,
+     -10,  5,  5,  5,  5,  5,  0,-10,
+     -10,  0,  5,  0,  0,  0,  0,-10,
+     -20,-10,-10, -5, -5,-10,-10,-20},
+    {-30,-40,-40,-50,-50,-40,-40,-30,   // king, middlegame
+     -30,-40,-40,-50,-50,-40,-40,-30,
+     -30,-40,-40,-50,-50,-40,-40,-30,
+     -30,-40,-40,-50,-50,-40,-40,-30,
+     -20,-30,-30,-40,-40,-30,-30,-20,
+     -10,-20,-20,-20,-20,-20,-20,-10,
+      20, 20,  0,  0,  0,  0, 20, 20,
+      20, 30, 10,  0,  0, 10, 30, 20},
+    {-50,-40,-30,-20,-20,-30,-40,-50,   // king, endgame
+     -30,-20,-10,  0,  0,-10,-20,-30,
+     -30,-10, 20, 30, 30, 20,-10,-30,
+     -30,-10, 30, 40, 40, 30,-10,-30,
+     -30,-10, 30, 40, 40, 30,-10,-30,
+     -30,-10, 20, 30, 30, 20,-10,-30,
+     -30,-30,  0,  0,  0,  0,-30,-30,
+     -50,-30,-30,-30,-30,-30,-30,-50},
+};
 
 static int highest_bit(BitBoard v) {
     const uint64_t b[] = {0x2, 0xC, 0xF0, 0xFF00, 0xFFFF0000, 0xFFFFFFFF00000000};
@@ -162,8 +273,28 @@ BitBoard chess_get_bitboard_from_index(int index) {
     return ((BitBoard) 1) << index;
 }
 
+// SplitMix64 from a fixed seed, so the hashes, and with them the searches, are the same in every run and on every platform
 static uint64_t rand_uint64_t() {
-    return ((uint64_t) rand()) ^ (((uint64_t) rand()) << 16) ^ (((uint64_t) rand()) << 32) ^ (((uint64_t) rand()) << 48);
+    static uint64_t state = 2025;
+    uint64_t z = (state += 0x9e3779b97f4a7c15ull);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+    return z ^ (z >> 31);
+}
+
+static once_flag zobrist_once = ONCE_FLAG_INIT;
+
+static void fill_zobrist_keys(void) {
+    for (int i = 0; i < 781; i++) {
+        zobrist_keys[i] = rand_uint64_t();
+    }
+}
+
+// Sets up the zobrist keys, if not already done.
+// Boards can be made without the UCI server (e.g. when unpacking), so this is separate from start_chess_api(),
+// and since offline tools may make their first boards on several threads at once, it runs exactly once.
+static void init_zobrist_keys() {
+    call_once(&zobrist_once, fill_zobrist_keys);
 }
 
 // Returns true if the boards are equal.
@@ -226,6 +357,11 @@ static Move load_move(char *movestr, Board *board) {
 // [buffer] should be at least 7 bytes
 static void dump_move(char *buffer, Move move) {
     memset(buffer, '\0', 7);
+    // the null move, which UCI writes as 0000
+    if (!move.from) {
+        memcpy(buffer, "0000", 4);
+        return;
+    }
     int sq_from = highest_bit(move.from);
     int sq_to = highest_bit(move.to);
     buffer[0] = 'a' + sq_from % 8;
@@ -327,6 +463,84 @@ static void calc_zobrist(Board *board) {
     board->hash = hash;
 }
 
+// Fills the internal piece-square tables from white-perspective tables [mg] and [eg], indexed by [piece type - 1][square]
+static void load_psqt(const int mg[6][64], const int eg[6][64]) {
+    for (int piece = 0; piece < 6; piece++) {
+        for (int sq = 0; sq < 64; sq++) {
+            psqt_mg[piece][sq] = mg[piece][sq];
+            psqt_eg[piece][sq] = eg[piece][sq];
+            psqt_mg[6 + piece][sq ^ 56] = -mg[piece][sq];
+            psqt_eg[6 + piece][sq ^ 56] = -eg[piece][sq];
+        }
+    }
+    psqt_loaded = true;
+}
+
+static void load_default_psqt() {
+    int mg[6][64], eg[6][64];
+    for (int piece = 0; piece < 6; piece++) {
+        const int *eg_positional = default_psqt_positional[(piece == KING - 1) ? 6 : piece];
+        for (int sq = 0; sq < 64; sq++) {
+            // default tables are stored rank 8 first, so flip them to a1 = 0
+            mg[piece][sq] = default_psqt_material[piece] + default_psqt_positional[piece][sq ^ 56];
+            eg[piece][sq] = default_psqt_material[piece] + eg_positional[sq ^ 56];
+        }
+    }
+    load_psqt(mg, eg);
+}
+
+// Returns the piece-square table index of the piece on [square] of [board], or -1 if the square is empty
+static int psqt_index_at(Board *board, BitBoard square) {
+    if (board->bb_white_pawn & square) return PAWN - 1;
+    if (board->bb_white_bishop & square) return BISHOP - 1;
+    if (board->bb_white_knight & square) return KNIGHT - 1;
+    if (board->bb_white_rook & square) return ROOK - 1;
+    if (board->bb_white_queen & square) return QUEEN - 1;
+    if (board->bb_white_king & square) return KING - 1;
+    if (board->bb_black_pawn & square) return 6 + PAWN - 1;
+    if (board->bb_black_bishop & square) return 6 + BISHOP - 1;
+    if (board->bb_black_knight & square) return 6 + KNIGHT - 1;
+    if (board->bb_black_rook & square) return 6 + ROOK - 1;
+    if (board->bb_black_queen & square) return 6 + QUEEN - 1;
+    if (board->bb_black_king & square) return 6 + KING - 1;
+    return -1;
+}
+
+static void psqt_add(Board *board, int index, int sq) {
+    board->psqt_mg += psqt_mg[index][sq];
+    board->psqt_eg += psqt_eg[index][sq];
+    board->phase += psqt_phase_weights[index % 6];
+}
+
+static void psqt_remove(Board *board, int index, int sq) {
+    board->psqt_mg -= psqt_mg[index][sq];
+    board->psqt_eg -= psqt_eg[index][sq];
+    board->phase -= psqt_phase_weights[index % 6];
+}
+
+static void psqt_move(Board *board, int index, int from, int to) {
+    board->psqt_mg += psqt_mg[index][to] - psqt_mg[index][from];
+    board->psqt_eg += psqt_eg[index][to] - psqt_eg[index][from];
+}
+
+// Loads the default tables, unless the bot loaded its own before making its first board
+static void load_default_psqt_once(void) {
+    if (!psqt_loaded) load_default_psqt();
+}
+
+// Set the piece-square accumulators for [board] from its current position
+static void calc_psqt(Board *board) {
+    // boards may first be made on several threads at once, so the default load runs exactly once
+    call_once(&psqt_once, load_default_psqt_once);
+    board->psqt_mg = 0;
+    board->psqt_eg = 0;
+    board->phase = 0;
+    for (int sq = 0; sq < 64; sq++) {
+        int index = psqt_index_at(board, ((BitBoard)1) << sq);
+        if (index >= 0) psqt_add(board, index, sq);
+    }
+}
+
 // Clears all piece bitboards for the [board], and clears the pseudo-legal move caches.
 static void clear_board(Board *board) {
     board->bb_black_bishop = 0;
@@ -350,6 +564,7 @@ static void clear_board(Board *board) {
         board->bb_white_moves = 0;
     }
     calc_zobrist(board);
+    calc_psqt(board);
 }
 
 static void set_board_from_fen(Board *board, const char *fen) {
@@ -395,7 +610,7 @@ static void set_board_from_fen(Board *board, const char *fen) {
     use_fen++;
     board->whiteToMove = (*use_fen == 'w');
     use_fen += 2;
-    while (*use_fen != ' ') {
+    while (*use_fen != ' ' && *use_fen != '\0') {
         switch (*use_fen) {
             case 'K': board->can_castle_wk = true; break;
             case 'Q': board->can_castle_wq = true; break;
@@ -404,12 +619,11 @@ static void set_board_from_fen(Board *board, const char *fen) {
         }
         use_fen++;
     }
-    use_fen++;
+    if (*use_fen) use_fen++;
     BitBoard ep_square = 1;
-    while (*use_fen != ' ') {
+    while (*use_fen != ' ' && *use_fen != '\0') {
         if (*use_fen == '-') {
             ep_square = 0;
-            break;
         } else if (*use_fen >= 'a' && *use_fen <= 'h') {
             ep_square <<= (*use_fen - 'a');
         } else if (*use_fen >= '1' && *use_fen <= '7') {
@@ -417,24 +631,27 @@ static void set_board_from_fen(Board *board, const char *fen) {
         }
         use_fen++;
     }
-    use_fen++;
+    if (*use_fen) use_fen++;
     board->en_passant_target = ep_square;
+    // the clocks are optional, and the string may end after any field
     int halfmoves = 0;
-    while (*use_fen != ' ') {
+    while (*use_fen >= '0' && *use_fen <= '9') {
         halfmoves *= 10;
         halfmoves += *use_fen - '0';
         use_fen++;
     }
-    use_fen++;
+    if (*use_fen) use_fen++;
     board->halfmoves = halfmoves;
     int fullmoves = 0;
-    while (*use_fen != ' ') {
+    while (*use_fen >= '0' && *use_fen <= '9') {
         fullmoves *= 10;
         fullmoves += *use_fen - '0';
         use_fen++;
     }
+    if (fullmoves == 0) fullmoves = 1;
     board->fullmoves = fullmoves;
     calc_zobrist(board);
+    calc_psqt(board);
 }
 
 // Makes a new, blank board. Caller responsible for freeing.
@@ -469,6 +686,256 @@ static Board *clone_board(Board * board) {
     return new_board;
 }
 
+// Creates a deep copy of the given board which shares no memory with [board].
+// Only the history back to the last irreversible move is copied, since no earlier position can repeat.
+// Caller responsible for freeing.
+static Board *clone_board_detached(Board *board) {
+    Board *new_board = (Board *)malloc(sizeof(Board));
+    memcpy(new_board, board, sizeof(Board));
+    new_board->bb_black_moves = NULL;
+    new_board->bb_white_moves = NULL;
+    new_board->refcount = 1;
+    Board *tail = new_board;
+    Board *src = board->last_board;
+    for (int i = 0; i < board->halfmoves && src != NULL; i++) {
+        Board *copy = (Board *)malloc(sizeof(Board));
+        memcpy(copy, src, sizeof(Board));
+        copy->bb_black_moves = NULL;
+        copy->bb_white_moves = NULL;
+        copy->refcount = 1;
+        tail->last_board = copy;
+        tail = copy;
+        src = src->last_board;
+    }
+    tail->last_board = NULL;
+    return new_board;
+}
+
+// Writes the hashes of the positions before [board] back to its last irreversible move, oldest first
+static int history_keys(Board *board, uint64_t *keys, int max) {
+    int count = 0;
+    for (Board *b = board->last_board; b != NULL && count < board->halfmoves && count < max; b = b->last_board)
+        keys[count++] = b->hash;
+    for (int i = 0; i < count / 2; i++) {
+        uint64_t swap = keys[i];
+        keys[i] = keys[count - 1 - i];
+        keys[count - 1 - i] = swap;
+    }
+    return count;
+}
+
+// Returns a pointer to the piece bitboard of [board] for the given piece-square table index
+static BitBoard *bitboard_for_index(Board *board, int index) {
+    switch (index) {
+        case PAWN - 1: return &board->bb_white_pawn;
+        case BISHOP - 1: return &board->bb_white_bishop;
+        case KNIGHT - 1: return &board->bb_white_knight;
+        case ROOK - 1: return &board->bb_white_rook;
+        case QUEEN - 1: return &board->bb_white_queen;
+        case KING - 1: return &board->bb_white_king;
+        case 6 + PAWN - 1: return &board->bb_black_pawn;
+        case 6 + BISHOP - 1: return &board->bb_black_bishop;
+        case 6 + KNIGHT - 1: return &board->bb_black_knight;
+        case 6 + ROOK - 1: return &board->bb_black_rook;
+        case 6 + QUEEN - 1: return &board->bb_black_queen;
+        default: return &board->bb_black_king;
+    }
+}
+
+_Static_assert(sizeof(PackedBoard) == 32, "PackedBoard must stay 32 bytes");
+
+// Packs [board] into the fixed-size binary format. Pieces are stored as one nibble each
+// (piece type, plus 8 for black) in ascending square order of the occupancy bitboard.
+static void pack_board(Board *board, PackedBoard *packed) {
+    memset(packed, 0, sizeof(PackedBoard));
+    BitBoard occupancy = board->bb_white_pawn | board->bb_white_bishop | board->bb_white_knight
+        | board->bb_white_rook | board->bb_white_queen | board->bb_white_king
+        | board->bb_black_pawn | board->bb_black_bishop | board->bb_black_knight
+        | board->bb_black_rook | board->bb_black_queen | board->bb_black_king;
+    packed->occupancy = occupancy;
+    int n = 0;
+    while (occupancy && n < 32) {
+        BitBoard square = occupancy & -occupancy;
+        int index = psqt_index_at(board, square);
+        uint8_t code = (uint8_t)((index % 6 + 1) | ((index >= 6) ? 8 : 0));
+        packed->pieces[n / 2] |= (n % 2) ? (code << 4) : code;
+        occupancy ^= square;
+        n++;
+    }
+    packed->flags = (board->whiteToMove ? 1 : 0)
+        | (board->can_castle_wk ? 2 : 0) | (board->can_castle_wq ? 4 : 0)
+        | (board->can_castle_bk ? 8 : 0) | (board->can_castle_bq ? 16 : 0);
+    packed->en_passant = board->en_passant_target ? (uint8_t)highest_bit(board->en_passant_target) : 0xff;
+    packed->halfmoves = (uint8_t)(board->halfmoves > 255 ? 255 : board->halfmoves);
+    packed->fullmoves = (uint16_t)(board->fullmoves > 65535 ? 65535 : board->fullmoves);
+}
+
+// Makes a new board from [packed]. Caller responsible for freeing.
+static Board *unpack_board(const PackedBoard *packed) {
+    init_zobrist_keys();
+    Board *board = create_board();
+    BitBoard occupancy = packed->occupancy;
+    int n = 0;
+    while (occupancy && n < 32) {
+        BitBoard square = occupancy & -occupancy;
+        uint8_t code = (packed->pieces[n / 2] >> ((n % 2) * 4)) & 0xf;
+        if ((code & 7) >= PAWN && (code & 7) <= KING) {
+            *bitboard_for_index(board, ((code & 8) ? 6 : 0) + (code & 7) - 1) |= square;
+        }
+        occupancy ^= square;
+        n++;
+    }
+    board->whiteToMove = (packed->flags & 1) != 0;
+    board->can_castle_wk = (packed->flags & 2) != 0;
+    board->can_castle_wq = (packed->flags & 4) != 0;
+    board->can_castle_bk = (packed->flags & 8) != 0;
+    board->can_castle_bq = (packed->flags & 16) != 0;
+    board->en_passant_target = (packed->en_passant < 64) ? ((BitBoard)1) << packed->en_passant : 0;
+    board->halfmoves = packed->halfmoves;
+    board->fullmoves = packed->fullmoves;
+    calc_zobrist(board);
+    calc_psqt(board);
+    return board;
+}
+
+// Writes the decimal digits of non-negative [value] to [buffer], returning the number of characters written
+static int write_uint(char *buffer, int value) {
+    char digits[12];
+    int len = 0;
+    do {
+        digits[len++] = (char)('0' + value % 10);
+        value /= 10;
+    } while (value > 0);
+    for (int i = 0; i < len; i++) buffer[i] = digits[len - 1 - i];
+    return len;
+}
+
+// Writes [board] as a FEN string into [buffer], returning its length.
+// [buffer] should be at least 92 bytes
+static int board_to_fen(Board *board, char *buffer) {
+    static const char piece_chars[12] = {'P', 'B', 'N', 'R', 'Q', 'K', 'p', 'b', 'n', 'r', 'q', 'k'};
+    char *out = buffer;
+    for (int rank = 7; rank >= 0; rank--) {
+        int empty = 0;
+        for (int file = 0; file < 8; file++) {
+            int index = psqt_index_at(board, ((BitBoard)1) << (rank * 8 + file));
+            if (index < 0) {
+                empty++;
+                continue;
+            }
+            if (empty > 0) *out++ = (char)('0' + empty);
+            empty = 0;
+            *out++ = piece_chars[index];
+        }
+        if (empty > 0) *out++ = (char)('0' + empty);
+        if (rank > 0) *out++ = '/';
+    }
+    *out++ = ' ';
+    *out++ = board->whiteToMove ? 'w' : 'b';
+    *out++ = ' ';
+    char *castling = out;
+    if (board->can_castle_wk) *out++ = 'K';
+    if (board->can_castle_wq) *out++ = 'Q';
+    if (board->can_castle_bk) *out++ = 'k';
+    if (board->can_castle_bq) *out++ = 'q';
+    if (out == castling) *out++ = '-';
+    *out++ = ' ';
+    if (board->en_passant_target) {
+        int ep = highest_bit(board->en_passant_target);
+        *out++ = (char)('a' + ep % 8);
+        *out++ = (char)('1' + ep / 8);
+    } else {
+        *out++ = '-';
+    }
+    *out++ = ' ';
+    out += write_uint(out, board->halfmoves);
+    *out++ = ' ';
+    out += write_uint(out, board->fullmoves);
+    *out = '\0';
+    return (int)(out - buffer);
+}
+
+// Returns the castling rights of [board] as a bitmask: 1 white kingside, 2 white queenside, 4 black kingside, 8 black queenside
+static int castle_rights(Board *board) {
+    return board->can_castle_wk | (board->can_castle_wq << 1) | (board->can_castle_bk << 2) | (board->can_castle_bq << 3);
+}
+
+// Returns the castling rights left on [board] after [move], in the format of castle_rights()
+static int castle_rights_after(Board *board, Move move) {
+    int rights = castle_rights(board);
+    // note: both squares are checked because someone taking our rooks also clears castle rights
+    BitBoard touched = move.to | move.from;
+    if (move.from & board->bb_white_king) rights &= ~3;
+    if (move.from & board->bb_black_king) rights &= ~12;
+    if (touched & 0x0000000000000080ull) rights &= ~1;
+    if (touched & 0x0000000000000001ull) rights &= ~2;
+    if (touched & 0x8000000000000000ull) rights &= ~4;
+    if (touched & 0x0100000000000000ull) rights &= ~8;
+    return rights;
+}
+
+// Returns the zobrist hash of the castling rights in [rights], in the format of castle_rights()
+static uint64_t castle_rights_hash(int rights) {
+    uint64_t hash = 0;
+    if (rights & 1) hash ^= zobrist_keys[770];
+    if (rights & 2) hash ^= zobrist_keys[771];
+    if (rights & 4) hash ^= zobrist_keys[768];
+    if (rights & 8) hash ^= zobrist_keys[769];
+    return hash;
+}
+
+// Returns the zobrist hash [board] would have after [move], without making the move.
+// Mirrors the hash updates done by make_move(), so that the two always agree.
+static uint64_t zobrist_after(Board *board, Move move) {
+    uint64_t hash = board->hash ^ zobrist_keys[772];
+    int from = highest_bit(move.from);
+    int to = highest_bit(move.to);
+    int moved = psqt_index_at(board, move.from);
+    if (moved < 0) {
+        // a null move, as made by chess_skip_turn(): only the side to move and the en passant target change
+        if (board->en_passant_target) hash ^= zobrist_keys[773 + highest_bit(board->en_passant_target) % 8];
+        return hash;
+    }
+    bool pawn_move = moved % 6 == PAWN - 1;
+    bool en_passant = pawn_move && (board->en_passant_target & move.to) > 0;
+    // en passant target
+    BitBoard ep = board->en_passant_target;
+    if (ep) hash ^= zobrist_keys[773 + highest_bit(ep) % 8];
+    if (pawn_move && (move.to & bb_slide_s(bb_slide_s(move.from)))) {
+        ep = bb_slide_s(move.from);
+    } else if (pawn_move && (move.to & bb_slide_n(bb_slide_n(move.from)))) {
+        ep = bb_slide_n(move.from);
+    } else if (!en_passant || move.capture) {
+        ep = 0;
+    }
+    if (ep) hash ^= zobrist_keys[773 + highest_bit(ep) % 8];
+    hash ^= castle_rights_hash(castle_rights(board) ^ castle_rights_after(board, move));
+    if (move.castle && moved % 6 == KING - 1) {
+        int rank = from & 56;
+        int rook = zobrist_piece_offset[moved - (KING - ROOK)];
+        hash ^= zobrist_keys[zobrist_piece_offset[moved] + from] ^ zobrist_keys[zobrist_piece_offset[moved] + to];
+        if (to > from) hash ^= zobrist_keys[rook + rank + 7] ^ zobrist_keys[rook + rank + 5];
+        else hash ^= zobrist_keys[rook + rank + 0] ^ zobrist_keys[rook + rank + 3];
+        return hash;
+    }
+    if (move.capture) {
+        BitBoard captured = move.to;
+        if (en_passant) captured = (moved < 6) ? bb_slide_s(move.to) : bb_slide_n(move.to);
+        int captured_index = psqt_index_at(board, captured);
+        if (captured_index >= 0) hash ^= zobrist_keys[zobrist_piece_offset[captured_index] + highest_bit(captured)];
+    }
+    hash ^= zobrist_keys[zobrist_piece_offset[moved] + from];
+    if (pawn_move && (move.to & 0xff000000000000ffull)) {
+        int color_offset = (moved >= 6) ? 6 : 0;
+        if (move.promotion >= BISHOP && move.promotion <= QUEEN) {
+            hash ^= zobrist_keys[zobrist_piece_offset[color_offset + move.promotion - 1] + to];
+        }
+    } else {
+        hash ^= zobrist_keys[zobrist_piece_offset[moved] + to];
+    }
+    return hash;
+}
+
 // Updates the [board] with the result of the given [move].
 // The previous board can be restored with undo_move().
 // Moves are presumed legal.
@@ -477,12 +944,18 @@ static void make_move(Board *board, Move move) {
     //saved_board->last_board = board->last_board;  // should be unnecessary
     if (board->last_board) free_board(board->last_board); // adjust refcount since we're removing a reference
     board->last_board = saved_board;
+    // the pseudo-legal move caches describe the position we're leaving, so they go with it into the history
+    saved_board->bb_white_moves = board->bb_white_moves;
+    saved_board->bb_black_moves = board->bb_black_moves;
+    board->bb_white_moves = NULL;
+    board->bb_black_moves = NULL;
     int from = highest_bit(move.from);
     int to = highest_bit(move.to);
+    int moved_index = psqt_index_at(board, move.from);
     uint64_t hash = board->hash;
     board->halfmoves++;
     BitBoard flip_pieces = move.to | move.from;
-    hash ^= highest_bit(board->en_passant_target) % 8; // xor out the old en passant hash
+    if (board->en_passant_target) hash ^= zobrist_keys[773 + highest_bit(board->en_passant_target) % 8];  // xor out the old en passant hash
     bool do_promotion = false;
     bool pawn_move = (move.from & (board->bb_black_pawn | board->bb_white_pawn)) > 0;
     bool en_passant = pawn_move && ((board->en_passant_target & move.to) > 0);
@@ -491,10 +964,8 @@ static void make_move(Board *board, Move move) {
         // set en passant target if double pawn move
         if ((move.to & bb_slide_s(bb_slide_s(move.from))) > 0) {
             board->en_passant_target = bb_slide_s(move.from);
-            hash ^= highest_bit(board->en_passant_target) % 8;  // xor in new en passant hash
         } else if ((move.to & bb_slide_n(bb_slide_n(move.from))) > 0) {
             board->en_passant_target = bb_slide_n(move.from);
-            hash ^= highest_bit(board->en_passant_target) % 8;  // xor in new en passant hash
         } else if (!en_passant) {
             board->en_passant_target = 0;
         }
@@ -504,36 +975,18 @@ static void make_move(Board *board, Move move) {
     } else {
         board->en_passant_target = 0;
     }
-    if (move.from & board->bb_white_king) {
-        if (board->can_castle_wk) hash ^= zobrist_keys[770];
-        if (board->can_castle_wq) hash ^= zobrist_keys[771];
-        board->can_castle_wk = false;
-        board->can_castle_wq = false;
-    } else if (move.from & board->bb_black_king) {
-        if (board->can_castle_bk) hash ^= zobrist_keys[768];
-        if (board->can_castle_bq) hash ^= zobrist_keys[769];
-        board->can_castle_bk = false;
-        board->can_castle_bq = false;
-    // note: flip_pieces used below because someone taking our rooks also clears castle rights
-    } else if (flip_pieces & 0x0000000000000001ull) {
-        if (board->can_castle_wq) hash ^= zobrist_keys[771];
-        board->can_castle_wq = false;
-    } else if (flip_pieces & 0x0000000000000080ull) {
-        if (board->can_castle_wk) hash ^= zobrist_keys[770];
-        board->can_castle_wk = false;
-    } else if (flip_pieces & 0x0100000000000000ull) {
-        if (board->can_castle_bq) hash ^= zobrist_keys[769];
-        board->can_castle_bq = false;
-    } else if (flip_pieces & 0x8000000000000000ull) {
-        if (board->can_castle_bk) hash ^= zobrist_keys[768];
-        board->can_castle_bk = false;
-    }
+    int rights = castle_rights_after(board, move);
+    hash ^= castle_rights_hash(castle_rights(board) ^ rights);
+    board->can_castle_wk = (rights & 1) != 0;
+    board->can_castle_wq = (rights & 2) != 0;
+    board->can_castle_bk = (rights & 4) != 0;
+    board->can_castle_bq = (rights & 8) != 0;
     if (move.castle) {
         if ((move.from & board->bb_white_king) > 0 && (move.to > move.from)) {
             // white castle kingside
             hash ^= zobrist_keys[64*10+4]^zobrist_keys[64*10+6]^zobrist_keys[64*7+7]^zobrist_keys[64*7+5];
-            if (board->can_castle_wk) hash ^= zobrist_keys[770];
-            if (board->can_castle_wq) hash ^= zobrist_keys[771];
+            psqt_move(board, KING - 1, 4, 6);
+            psqt_move(board, ROOK - 1, 7, 5);
             board->bb_white_king ^= 80ull;
             board->bb_white_rook ^= 160ull;
             board->can_castle_wk = false;
@@ -541,26 +994,26 @@ static void make_move(Board *board, Move move) {
         } else if ((move.from & board->bb_white_king) > 0 && (move.to < move.from)) {
             // white castle queenside
             hash ^= zobrist_keys[64*10+4]^zobrist_keys[64*10+2]^zobrist_keys[64*7+0]^zobrist_keys[64*7+3];
-            if (board->can_castle_wk) hash ^= zobrist_keys[770];
-            if (board->can_castle_wq) hash ^= zobrist_keys[771];
+            psqt_move(board, KING - 1, 4, 2);
+            psqt_move(board, ROOK - 1, 0, 3);
             board->bb_white_king ^= 20ull;
             board->bb_white_rook ^= 9ull;
             board->can_castle_wk = false;
             board->can_castle_wq = false;
         } else if ((move.from & board->bb_black_king) > 0 && (move.to > move.from)) {
             // black castle kingside
-            hash ^= zobrist_keys[64*10+56+4]^zobrist_keys[64*10+56+6]^zobrist_keys[64*7+56+7]^zobrist_keys[64*7+56+5];
-            if (board->can_castle_bk) hash ^= zobrist_keys[768];
-            if (board->can_castle_bq) hash ^= zobrist_keys[769];
+            hash ^= zobrist_keys[64*4+56+4]^zobrist_keys[64*4+56+6]^zobrist_keys[64*1+56+7]^zobrist_keys[64*1+56+5];
+            psqt_move(board, 6 + KING - 1, 60, 62);
+            psqt_move(board, 6 + ROOK - 1, 63, 61);
             board->bb_black_king ^= 5764607523034234880ull;
             board->bb_black_rook ^= 11529215046068469760ull;
             board->can_castle_bk = false;
             board->can_castle_bq = false;
         } else if ((move.from & board->bb_black_king) > 0 && (move.to < move.from)) {
             // black castle queenside
-            hash ^= zobrist_keys[64*10+56+4]^zobrist_keys[64*10+56+2]^zobrist_keys[64*7+56+0]^zobrist_keys[64*7+56+3];
-            if (board->can_castle_bk) hash ^= zobrist_keys[768];
-            if (board->can_castle_bq) hash ^= zobrist_keys[769];
+            hash ^= zobrist_keys[64*4+56+4]^zobrist_keys[64*4+56+2]^zobrist_keys[64*1+56+0]^zobrist_keys[64*1+56+3];
+            psqt_move(board, 6 + KING - 1, 60, 58);
+            psqt_move(board, 6 + ROOK - 1, 56, 59);
             board->bb_black_king ^= 1441151880758558720ull;
             board->bb_black_rook ^= 648518346341351424ull;
             board->can_castle_bk = false;
@@ -570,6 +1023,7 @@ static void make_move(Board *board, Move move) {
             board->fullmoves++;
         }
         board->whiteToMove = !board->whiteToMove;
+        if (board->en_passant_target) hash ^= zobrist_keys[773 + highest_bit(board->en_passant_target) % 8];  // xor in new en passant hash
         hash ^= zobrist_keys[772];  // update color-to-play hash
         board->hash = hash;  // commit hash
         return;
@@ -605,6 +1059,8 @@ static void make_move(Board *board, Move move) {
         hash ^= ((board->bb_white_queen & inv_cap_mask) > 0) * (zobrist_keys[64*9 + cap_at]);
         hash ^= ((board->bb_white_king & inv_cap_mask) > 0) * (zobrist_keys[64*10 + cap_at]);
         hash ^= ((board->bb_white_knight & inv_cap_mask) > 0) * (zobrist_keys[64*11 + cap_at]);
+        int cap_index = psqt_index_at(board, inv_cap_mask);
+        if (cap_index >= 0) psqt_remove(board, cap_index, cap_at);
         // remove captured piece
         board->bb_black_bishop &= cap_mask;
         board->bb_black_rook &= cap_mask;
@@ -632,6 +1088,7 @@ static void make_move(Board *board, Move move) {
     hash ^= ((board->bb_white_queen & move.from) > 0) * (zobrist_keys[64*9 + from] ^ zobrist_keys[64*9 + to]);
     hash ^= ((board->bb_white_king & move.from) > 0) * (zobrist_keys[64*10 + from] ^ zobrist_keys[64*10 + to]);
     hash ^= ((board->bb_white_knight & move.from) > 0) * (zobrist_keys[64*11 + from] ^ zobrist_keys[64*11 + to]);
+    if (moved_index >= 0) psqt_move(board, moved_index, from, to);
     // remove old moved piece
     board->bb_black_bishop ^= ((board->bb_black_bishop & move.from) > 0) * flip_pieces;
     board->bb_black_rook ^= ((board->bb_black_rook & move.from) > 0) * flip_pieces;
@@ -646,30 +1103,34 @@ static void make_move(Board *board, Move move) {
     board->bb_white_knight ^= ((board->bb_white_knight & move.from) > 0) * flip_pieces;
     board->bb_white_pawn ^= ((board->bb_white_pawn & move.from) > 0) * flip_pieces;
     if (do_promotion) {
+        int color_offset = (moved_index >= 6) ? 6 : 0;
+        psqt_remove(board, color_offset + PAWN - 1, to);
+        hash ^= zobrist_keys[zobrist_piece_offset[color_offset + PAWN - 1] + to];
+        if (move.promotion >= BISHOP && move.promotion <= QUEEN) psqt_add(board, color_offset + move.promotion - 1, to);
         switch (move.promotion) {
             case BISHOP:
                 board->bb_white_bishop |= (move.to & board->bb_white_pawn);
                 board->bb_black_bishop |= (move.to & board->bb_black_pawn);
-                hash ^= (move.to & board->bb_white_pawn)*(zobrist_keys[64*8+to]+zobrist_keys[64*6+to]);
-                hash ^= (move.to & board->bb_black_pawn)*(zobrist_keys[64*2+to]+zobrist_keys[64*0+to]);
+                if (move.to & board->bb_white_pawn) hash ^= zobrist_keys[64*8+to];
+                if (move.to & board->bb_black_pawn) hash ^= zobrist_keys[64*2+to];
                 break;
             case ROOK:
                 board->bb_white_rook |= (move.to & board->bb_white_pawn);
                 board->bb_black_rook |= (move.to & board->bb_black_pawn);
-                hash ^= (move.to & board->bb_white_pawn)*(zobrist_keys[64*7+to]+zobrist_keys[64*6+to]);
-                hash ^= (move.to & board->bb_black_pawn)*(zobrist_keys[64*1+to]+zobrist_keys[64*0+to]);
+                if (move.to & board->bb_white_pawn) hash ^= zobrist_keys[64*7+to];
+                if (move.to & board->bb_black_pawn) hash ^= zobrist_keys[64*1+to];
                 break;
             case KNIGHT:
                 board->bb_white_knight |= (move.to & board->bb_white_pawn);
                 board->bb_black_knight |= (move.to & board->bb_black_pawn);
-                hash ^= (move.to & board->bb_white_pawn)*(zobrist_keys[64*11+to]+zobrist_keys[64*6+to]);
-                hash ^= (move.to & board->bb_black_pawn)*(zobrist_keys[64*5+to]+zobrist_keys[64*0+to]);
+                if (move.to & board->bb_white_pawn) hash ^= zobrist_keys[64*11+to];
+                if (move.to & board->bb_black_pawn) hash ^= zobrist_keys[64*5+to];
                 break;
             case QUEEN:
                 board->bb_white_queen |= (move.to & board->bb_white_pawn);
                 board->bb_black_queen |= (move.to & board->bb_black_pawn);
-                hash ^= (move.to & board->bb_white_pawn)*(zobrist_keys[64*9+to]+zobrist_keys[64*6+to]);
-                hash ^= (move.to & board->bb_black_pawn)*(zobrist_keys[64*3+to]+zobrist_keys[64*0+to]);
+                if (move.to & board->bb_white_pawn) hash ^= zobrist_keys[64*9+to];
+                if (move.to & board->bb_black_pawn) hash ^= zobrist_keys[64*3+to];
                 break;
         }
         board->bb_white_pawn &= ~move.to;
@@ -679,6 +1140,7 @@ static void make_move(Board *board, Move move) {
         board->fullmoves++;
     }
     board->whiteToMove = !board->whiteToMove;
+    if (board->en_passant_target) hash ^= zobrist_keys[773 + highest_bit(board->en_passant_target) % 8];  // xor in new en passant hash
     hash ^= zobrist_keys[772];  // update color-to-play hash
     board->hash = hash;  // commit hash
 }
@@ -702,6 +1164,9 @@ static void undo_move(Board *board) {
     board->whiteToMove = restore->whiteToMove;
     board->en_passant_target = restore->en_passant_target;
     board->hash = restore->hash;
+    board->psqt_mg = restore->psqt_mg;
+    board->psqt_eg = restore->psqt_eg;
+    board->phase = restore->phase;
     // free old move caches before overwriting
     if (board->bb_white_moves != NULL) {
         free(board->bb_white_moves);
@@ -719,7 +1184,91 @@ static void undo_move(Board *board) {
     free_board(restore);
 }
 
+// UCI option names are case insensitive
+static SpinOption *find_option(const char *name) {
+    for (int i = 0; i < option_count; i++) {
+        const char *a = options[i].name, *b = name;
+        while (*a && *b && tolower((unsigned char)*a) == tolower((unsigned char)*b)) {
+            a++;
+            b++;
+        }
+        if (*a == '\0' && *b == '\0') return &options[i];
+    }
+    return NULL;
+}
+
+// Declares a spin option, or changes the declaration if the name is already taken
+static void add_spin_option(const char *name, int default_value, int min, int max) {
+    SpinOption *option = find_option(name);
+    if (option == NULL) {
+        if (option_count == MAX_OPTIONS) return;
+        option = &options[option_count++];
+    }
+    snprintf(option->name, MAX_OPTION_NAME, "%s", name);
+    option->default_value = default_value;
+    option->min = min;
+    option->max = max;
+    option->value = default_value;
+}
+
+// Sets an option from a "setoption" command, clamping the value into range; unknown names are ignored
+static void set_option(const char *name, const char *value) {
+    SpinOption *option = find_option(name);
+    if (option == NULL || value == NULL) return;
+    long parsed = strtol(value, NULL, 10);
+    option->value = parsed < option->min ? option->min : parsed > option->max ? option->max : (int)parsed;
+}
+
 // Listens for and responds to UCI messages from the GUI. Updates API state as needed.
+// Reads the value after a "go" keyword, or 0 if it's missing; some GUIs send negative times once a clock runs out
+static uint64_t go_value() {
+    char *raw = strtok(NULL, " ");
+    long long value = raw != NULL ? strtoll(raw, NULL, 10) : 0;
+    return value > 0 ? (uint64_t)value : 0;
+}
+
+// Returns whether [token] is a move in UCI notation, such as e2e4 or a7a8q
+static bool is_uci_move(const char *token) {
+    size_t len = strlen(token);
+    return (len == 4 || len == 5) && token[0] >= 'a' && token[0] <= 'h' && token[1] >= '1' && token[1] <= '8'
+        && token[2] >= 'a' && token[2] <= 'h' && token[3] >= '1' && token[3] <= '8';
+}
+
+// Milliseconds on a monotonic wall clock. clock() measures the CPU time of the whole process, which runs ahead of the
+// real time as soon as the bot searches on more than one thread.
+static uint64_t monotonic_millis() {
+#ifdef _WIN32
+    LARGE_INTEGER frequency, now;
+    QueryPerformanceFrequency(&frequency);
+    QueryPerformanceCounter(&now);
+    return (uint64_t)(now.QuadPart / frequency.QuadPart * 1000 + now.QuadPart % frequency.QuadPart * 1000 / frequency.QuadPart);
+#else
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000 + now.tv_nsec / 1000000;
+#endif
+}
+
+// Packs [move] into one word, so it can be published with a single atomic store: 0 for no move, otherwise
+// bit 0 set, the from and to square indices in bits 1-6 and 7-12, the promotion in bits 13-15, and the capture and castle flags
+static uint32_t pack_move(Move move) {
+    if (!move.from) return 0;
+    return 1u | (uint32_t)highest_bit(move.from) << 1 | (uint32_t)highest_bit(move.to) << 7
+        | (uint32_t)move.promotion << 13 | (uint32_t)move.capture << 16 | (uint32_t)move.castle << 17;
+}
+
+// The reverse of pack_move()
+static Move unpack_move(uint32_t packed) {
+    Move move = {0};
+    if (!packed) return move;
+    move.from = 1ull << ((packed >> 1) & 63);
+    move.to = 1ull << ((packed >> 7) & 63);
+    move.promotion = (packed >> 13) & 7;
+    move.capture = (packed >> 16) & 1;
+    move.castle = (packed >> 17) & 1;
+    return move;
+}
+
 static int uci_process(void *arg) {
     char line[4096];
     bool running = true;
@@ -735,6 +1284,10 @@ static int uci_process(void *arg) {
             if (!strcmp(token, "uci")) {
                 printf("id name %s\n", CHESS_BOT_NAME);
                 printf("id author %s\n", BOT_AUTHOR_NAME);
+                printf("option name Ponder type check default false\n");
+                for (int i = 0; i < option_count; i++)
+                    printf("option name %s type spin default %d min %d max %d\n",
+                           options[i].name, options[i].default_value, options[i].min, options[i].max);
                 printf("uciok\n");
                 fflush(stdout);
             } else if (!strcmp(token, "isready")) {
@@ -743,7 +1296,7 @@ static int uci_process(void *arg) {
             } else if (!strcmp(token, "position")) {
                 //pthread_mutex_lock(&API->mutex);
                 mtx_lock(&API->mutex);
-                memset(&API->latest_opponent_move, 0, sizeof(Move));
+                atomic_store(&API->latest_opponent_move, 0);
                 token = strtok(NULL, " ");
                 if (!strcmp(token, "fen")) {
                     char fenstring[256];
@@ -770,7 +1323,7 @@ static int uci_process(void *arg) {
                 }
                 if (token != NULL && !strcmp(token, "moves")) {
                     char *move = strtok(NULL, " ");
-                    Move m;
+                    Move m = {0};
                     while (move != NULL) {
                         m = load_move(move, API->shared_board);
                         make_move(API->shared_board, m);
@@ -783,33 +1336,106 @@ static int uci_process(void *arg) {
                         printf("black: \n%s\n", bitboard_dump);*/
                         move = strtok(NULL, " ");
                     }
-                    API->latest_opponent_move = m;
+                    atomic_store(&API->latest_opponent_move, pack_move(m));
                 }
                 //pthread_mutex_unlock(&API->mutex);
                 mtx_unlock(&API->mutex);
             } else if (!strcmp(token, "go")) {
                 //pthread_mutex_lock(&API->mutex);
                 mtx_lock(&API->mutex);
+                atomic_store(&API->pondering, false);
+                atomic_store(&API->stop_requested, false);
+                // a bot that pushes nothing answers with the null move, not with its move from the last search
+                memset(&API->latest_pushed_move, 0, sizeof(Move));
+                memset(&API->ponder_move, 0, sizeof(Move));
+                API->searching = true;
+                // every search starts from no limits, so nothing carries over from the last "go"
+                memset(&API->limits, 0, sizeof(SearchLimits));
+                API->search_move_count = 0;
                 token = strtok(NULL, " ");
                 while (token != NULL) {
-                    if (!strcmp(token, "wtime")) {
-                        char *rawtime = strtok(NULL, " ");
-                        API->wtime = strtol(rawtime, NULL, 10);
+                    if (!strcmp(token, "ponder")) {
+                        atomic_store(&API->pondering, true);
+                    } else if (!strcmp(token, "wtime")) {
+                        API->limits.wtime = go_value();
+                        API->limits.wtime_given = true;
                     } else if (!strcmp(token, "btime")) {
-                        char *rawtime = strtok(NULL, " ");
-                        API->btime = strtol(rawtime, NULL, 10);
+                        API->limits.btime = go_value();
+                        API->limits.btime_given = true;
+                    } else if (!strcmp(token, "winc")) {
+                        API->limits.winc = go_value();
+                    } else if (!strcmp(token, "binc")) {
+                        API->limits.binc = go_value();
+                    } else if (!strcmp(token, "movestogo")) {
+                        API->limits.movestogo = (int)go_value();
+                    } else if (!strcmp(token, "movetime")) {
+                        API->limits.movetime = go_value();
+                    } else if (!strcmp(token, "depth")) {
+                        API->limits.depth = (int)go_value();
+                    } else if (!strcmp(token, "nodes")) {
+                        API->limits.nodes = go_value();
+                    } else if (!strcmp(token, "mate")) {
+                        API->limits.mate = (int)go_value();
                     } else if (!strcmp(token, "infinite")) {
-                        API->btime = (uint64_t)1<<31;
-                        API->wtime = (uint64_t)1<<31;
+                        API->limits.infinite = true;
+                    } else if (!strcmp(token, "searchmoves")) {
+                        // the moves run until the next keyword
+                        while ((token = strtok(NULL, " ")) != NULL && is_uci_move(token)) {
+                            if (API->search_move_count < MAX_SEARCH_MOVES)
+                                API->search_moves[API->search_move_count++] = load_move(token, API->shared_board);
+                        }
+                        continue;
                     }
                     token = strtok(NULL, " ");
                 }
+                // published before the bot is released, so its first look at the clock already sees this turn
+                bool white = API->shared_board == NULL || API->shared_board->whiteToMove;
+                atomic_store(&API->time_millis, white ? API->limits.wtime : API->limits.btime);
+                atomic_store(&API->opponent_time_millis, white ? API->limits.btime : API->limits.wtime);
+                atomic_store(&API->turn_started_millis, monotonic_millis());
                 semaphore_post(&API->intermission_mutex);
-                API->turn_started_time = clock();
                 //pthread_mutex_unlock(&API->mutex);
                 mtx_unlock(&API->mutex);
+            } else if (!strcmp(token, "setoption")) {
+                // setoption name <id> [value <x>], where the name may contain spaces
+                char name[MAX_OPTION_NAME] = "";
+                char *value = NULL;
+                token = strtok(NULL, " ");
+                if (token != NULL && !strcmp(token, "name")) {
+                    while ((token = strtok(NULL, " ")) != NULL && strcmp(token, "value")) {
+                        if (name[0] && strlen(name) + 1 < MAX_OPTION_NAME) strcat(name, " ");
+                        strncat(name, token, MAX_OPTION_NAME - strlen(name) - 1);
+                    }
+                    if (token != NULL) value = strtok(NULL, " ");
+                }
+                mtx_lock(&API->mutex);
+                set_option(name, value);
+                mtx_unlock(&API->mutex);
+            } else if (!strcmp(token, "ponderhit")) {
+                // the opponent played the move we pondered on, so the search carries on as a normal one from here
+                // the clock restarts before pondering ends, so a search that sees the ponderhit also sees the new start
+                mtx_lock(&API->mutex);
+                atomic_store(&API->turn_started_millis, monotonic_millis());
+                atomic_store(&API->pondering, false);
+                mtx_unlock(&API->mutex);
             } else if (!strcmp(token, "stop")) {
-                // does nothing for now
+                mtx_lock(&API->mutex);
+                atomic_store(&API->pondering, false);
+                mtx_unlock(&API->mutex);
+                atomic_store(&API->stop_requested, true);
+            } else if (!strcmp(token, "bench")) {
+                // the hook gets the rest of the line, so it takes whatever arguments it likes
+                char *args = strtok(NULL, "");
+                // the bench shares the bot's search state, so it only runs between searches; none can start
+                // while it runs, since "go" is read on this same thread
+                mtx_lock(&API->mutex);
+                bool busy = API->searching;
+                if (busy) {
+                    printf("info string bench is not available during a search\n");
+                    fflush(stdout);
+                }
+                mtx_unlock(&API->mutex);
+                if (!busy && bench_hook) bench_hook(args != NULL ? args : "", bench_context);
             } else if (!strcmp(token, "quit")) {
                 //pthread_cancel(API->uci_thread);
                 running = false;
@@ -835,16 +1461,47 @@ static void dump_api_move(char *buffer) {
 }
 
 static void uci_info() {
+    // the null move isn't one the search is considering
+    if (!API->latest_pushed_move.from) return;
     char move[8];
     dump_api_move(move);
     printf("info currmove %s\n", move);
     fflush(stdout);
 }
 
+static void uci_send_info(const SearchInfo *info) {
+    char line[2048];
+    int n = snprintf(line, sizeof(line), "info depth %d seldepth %d", info->depth, info->seldepth);
+    if (info->multipv > 0)
+        n += snprintf(line + n, sizeof(line) - n, " multipv %d", info->multipv);
+    n += snprintf(line + n, sizeof(line) - n, " score %s %d nodes %llu nps %llu", info->mate ? "mate" : "cp", info->score,
+                  (unsigned long long)info->nodes,
+                  (unsigned long long)(info->nodes * 1000 / (info->time_millis ? info->time_millis : 1)));
+    if (info->hashfull >= 0)
+        n += snprintf(line + n, sizeof(line) - n, " hashfull %d", info->hashfull);
+    n += snprintf(line + n, sizeof(line) - n, " time %llu", (unsigned long long)info->time_millis);
+    if (info->pv_length > 0)
+        n += snprintf(line + n, sizeof(line) - n, " pv");
+    // a move takes at most 6 characters with its space, and the line ending 2 more
+    for (int i = 0; i < info->pv_length && n + 8 < (int)sizeof(line); i++) {
+        char move[8];
+        dump_move(move, info->pv[i]);
+        n += snprintf(line + n, sizeof(line) - n, " %s", move);
+    }
+    printf("%s\n", line);
+    fflush(stdout);
+}
+
 static void uci_finished_searching() {
     char move[8];
     dump_api_move(move);
-    printf("bestmove %s\n", move);
+    if (API->ponder_move.from) {
+        char ponder[8];
+        dump_move(ponder, API->ponder_move);
+        printf("bestmove %s ponder %s\n", move, ponder);
+    } else {
+        printf("bestmove %s\n", move);
+    }
     fflush(stdout);
 }
 
@@ -854,15 +1511,31 @@ static void interface_push(Move move) {
     // pthread_mutex_lock(&API->mutex);
     mtx_lock(&API->mutex);
     API->latest_pushed_move = move;
+    // any ponder move was a reply to the old move
+    memset(&API->ponder_move, 0, sizeof(Move));
     uci_info();
     // pthread_mutex_unlock(&API->mutex);
     mtx_unlock(&API->mutex);
 }
 
+static void interface_send_info(const SearchInfo *info) {
+    mtx_lock(&API->mutex);
+    uci_send_info(info);
+    mtx_unlock(&API->mutex);
+}
+
+static void interface_send_info_string(const char *text) {
+    mtx_lock(&API->mutex);
+    printf("info string %s\n", text);
+    fflush(stdout);
+    mtx_unlock(&API->mutex);
+}
+
 static void interface_done() {
     //pthread_mutex_lock(&API->mutex);
     mtx_lock(&API->mutex);
     uci_finished_searching();
+    API->searching = false;
     //pthread_mutex_unlock(&API->mutex);
     mtx_unlock(&API->mutex);
     semaphore_wait(&API->intermission_mutex);
@@ -877,40 +1550,95 @@ static Board *interface_get_board() {
     return board;
 }
 
+// the clock, ponder, stop and opponent move accessors take no lock, so a search can poll them as often as it likes
+
 static uint64_t interface_get_time_millis() {
-    //pthread_mutex_lock(&API->mutex);
+    return atomic_load(&API->time_millis);
+}
+
+static uint64_t interface_get_opponent_time_millis() {
+    return atomic_load(&API->opponent_time_millis);
+}
+
+static uint64_t interface_get_elapsed_time_millis() {
+    return monotonic_millis() - atomic_load(&API->turn_started_millis);
+}
+
+static void interface_push_ponder(Move move) {
     mtx_lock(&API->mutex);
-    uint64_t millis = API->shared_board->whiteToMove ? API->wtime : API->btime;
-    //pthread_mutex_unlock(&API->mutex);
+    API->ponder_move = move;
     mtx_unlock(&API->mutex);
-    return millis;
 }
 
-static uint64_t interface_get_opponent_time_millis() {
-    //pthread_mutex_lock(&API->mutex);
+static uint64_t interface_get_node_limit() {
     mtx_lock(&API->mutex);
-    uint64_t millis = API->shared_board->whiteToMove ? API->btime : API->wtime;
-    //pthread_mutex_unlock(&API->mutex);
+    uint64_t nodes = API->limits.nodes;
+    mtx_unlock(&API->mutex);
+    return nodes;
+}
+
+static int interface_get_depth_limit() {
+    mtx_lock(&API->mutex);
+    int depth = API->limits.depth;
+    mtx_unlock(&API->mutex);
+    return depth;
+}
+
+static bool interface_is_pondering() {
+    return atomic_load(&API->pondering);
+}
+
+static uint64_t interface_get_increment_millis() {
+    mtx_lock(&API->mutex);
+    // without a position yet, white is to move, as for the clocks
+    bool white = API->shared_board == NULL || API->shared_board->whiteToMove;
+    uint64_t millis = white ? API->limits.winc : API->limits.binc;
     mtx_unlock(&API->mutex);
     return millis;
 }
 
-static uint64_t interface_get_elapsed_time_millis() {
-    //pthread_mutex_lock(&API->mutex);
+static int interface_get_movestogo() {
     mtx_lock(&API->mutex);
-    uint64_t millis = (clock() - API->turn_started_time) / (CLOCKS_PER_SEC / 1000);
-    //pthread_mutex_unlock(&API->mutex);
+    int moves = API->limits.movestogo;
+    mtx_unlock(&API->mutex);
+    return moves;
+}
+
+static uint64_t interface_get_movetime() {
+    mtx_lock(&API->mutex);
+    uint64_t millis = API->limits.movetime;
     mtx_unlock(&API->mutex);
     return millis;
 }
 
-static Move interface_get_opponent_move() {
-    //pthread_mutex_lock(&API->mutex);
+static void interface_get_search_limits(SearchLimits *limits) {
     mtx_lock(&API->mutex);
-    Move move = API->latest_opponent_move;
-    //pthread_mutex_unlock(&API->mutex);
+    *limits = API->limits;
     mtx_unlock(&API->mutex);
-    return move;
+}
+
+static int interface_get_search_moves(Move *moves, int max) {
+    mtx_lock(&API->mutex);
+    int count = API->search_move_count < max ? API->search_move_count : max;
+    memcpy(moves, API->search_moves, count * sizeof(Move));
+    mtx_unlock(&API->mutex);
+    return count;
+}
+
+static bool interface_should_stop() {
+    return atomic_load(&API->stop_requested);
+}
+
+static int interface_get_option(const char *name) {
+    mtx_lock(&API->mutex);
+    SpinOption *option = find_option(name);
+    int value = option ? option->value : 0;
+    mtx_unlock(&API->mutex);
+    return value;
+}
+
+static Move interface_get_opponent_move() {
+    return unpack_move(atomic_load(&API->latest_opponent_move));
 }
 
 static bool is_white_turn(Board *board) {
@@ -932,88 +1660,77 @@ static bool is_white_turn(Board *board) {
         } \
     }
 
-static BitBoard get_pins_ns(Board *board, bool white) {
+// Shorthands for the piece bitboards of the side being considered, and of its opponent ([white] must be in scope).
+#define MY(piece) (white ? board->bb_white_ ## piece : board->bb_black_ ## piece)
+#define OPP(piece) (white ? board->bb_black_ ## piece : board->bb_white_ ## piece)
+
+// Move generation is written once against a [white] parameter, and these functions are forced inline so that each
+// call with a constant color becomes its own specialization: the color branches, pawn directions and promotion ranks
+// all fold at compile time. gen_legal_white() and gen_legal_black() below are the roots of the two specializations.
+#if defined(_MSC_VER)
+    #define FORCE_INLINE __forceinline
+#else
+    #define FORCE_INLINE inline __attribute__((always_inline))
+#endif
+
+static FORCE_INLINE BitBoard get_pins_ns(Board *board, const bool white) {
     BitBoard pins = 0;
-    BitBoard white_level_pieces = board->bb_white_rook | board->bb_white_queen;
-    BitBoard black_level_pieces = board->bb_black_rook | board->bb_black_queen;
-    BitBoard all_pieces_white = board->bb_white_bishop | board->bb_white_king
+    BitBoard all_pieces = board->bb_white_bishop | board->bb_white_king
         | board->bb_white_knight | board->bb_white_pawn | board->bb_white_queen
-        | board->bb_white_rook;
-    BitBoard all_pieces_black = board->bb_black_bishop | board->bb_black_king
+        | board->bb_white_rook | board->bb_black_bishop | board->bb_black_king
         | board->bb_black_knight | board->bb_black_pawn | board->bb_black_queen
         | board->bb_black_rook;
-    BitBoard all_pieces = all_pieces_black | all_pieces_white;
-    BitBoard my_pieces = white ? all_pieces_white : all_pieces_black;
-    BitBoard opp_level_pieces = white ? black_level_pieces : white_level_pieces;
-    BitBoard opp_attackers = opp_level_pieces;
-    BitBoard my_king = white ? board->bb_white_king : board->bb_black_king;
-    // check for horz/vert pins
+    BitBoard opp_attackers = OPP(rook) | OPP(queen);
+    BitBoard my_king = MY(king);
+    // check for vert pins
     BitBoard gen, last_my;
     get_pin(n)
     get_pin(s)
     return pins;
 }
 
-static BitBoard get_pins_ew(Board *board, bool white) {
+static FORCE_INLINE BitBoard get_pins_ew(Board *board, const bool white) {
     BitBoard pins = 0;
-    BitBoard white_level_pieces = board->bb_white_rook | board->bb_white_queen;
-    BitBoard black_level_pieces = board->bb_black_rook | board->bb_black_queen;
-    BitBoard all_pieces_white = board->bb_white_bishop | board->bb_white_king
+    BitBoard all_pieces = board->bb_white_bishop | board->bb_white_king
         | board->bb_white_knight | board->bb_white_pawn | board->bb_white_queen
-        | board->bb_white_rook;
-    BitBoard all_pieces_black = board->bb_black_bishop | board->bb_black_king
+        | board->bb_white_rook | board->bb_black_bishop | board->bb_black_king
         | board->bb_black_knight | board->bb_black_pawn | board->bb_black_queen
         | board->bb_black_rook;
-    BitBoard all_pieces = all_pieces_black | all_pieces_white;
-    BitBoard my_pieces = white ? all_pieces_white : all_pieces_black;
-    BitBoard opp_level_pieces = white ? black_level_pieces : white_level_pieces;
-    BitBoard opp_attackers = opp_level_pieces;
-    BitBoard my_king = white ? board->bb_white_king : board->bb_black_king;
-    // check for horz/vert pins
+    BitBoard opp_attackers = OPP(rook) | OPP(queen);
+    BitBoard my_king = MY(king);
+    // check for horz pins
     BitBoard gen, last_my;
     get_pin(e)
     get_pin(w)
     return pins;
 }
 
-static BitBoard get_pins_nesw(Board *board, bool white) {
+static FORCE_INLINE BitBoard get_pins_nesw(Board *board, const bool white) {
     BitBoard pins = 0;
-    BitBoard white_diag_pieces = board->bb_white_bishop | board->bb_white_queen;
-    BitBoard black_diag_pieces = board->bb_black_bishop | board->bb_black_queen;
-    BitBoard all_pieces_white = board->bb_white_bishop | board->bb_white_king
+    BitBoard all_pieces = board->bb_white_bishop | board->bb_white_king
         | board->bb_white_knight | board->bb_white_pawn | board->bb_white_queen
-        | board->bb_white_rook;
-    BitBoard all_pieces_black = board->bb_black_bishop | board->bb_black_king
+        | board->bb_white_rook | board->bb_black_bishop | board->bb_black_king
         | board->bb_black_knight | board->bb_black_pawn | board->bb_black_queen
         | board->bb_black_rook;
-    BitBoard all_pieces = all_pieces_black | all_pieces_white;
-    BitBoard my_pieces = white ? all_pieces_white : all_pieces_black;
-    BitBoard opp_diag_pieces = white ? black_diag_pieces : white_diag_pieces;
-    BitBoard opp_attackers = opp_diag_pieces;
-    BitBoard my_king = white ? board->bb_white_king : board->bb_black_king;
-    // check for horz/vert pins
+    BitBoard opp_attackers = OPP(bishop) | OPP(queen);
+    BitBoard my_king = MY(king);
+    // check for diagonal pins
     BitBoard gen, last_my;
     get_pin(ne)
     get_pin(sw)
     return pins;
 }
 
-static BitBoard get_pins_nwse(Board *board, bool white) {
+static FORCE_INLINE BitBoard get_pins_nwse(Board *board, const bool white) {
     BitBoard pins = 0;
-    BitBoard white_diag_pieces = board->bb_white_bishop | board->bb_white_queen;
-    BitBoard black_diag_pieces = board->bb_black_bishop | board->bb_black_queen;
-    BitBoard all_pieces_white = board->bb_white_bishop | board->bb_white_king
+    BitBoard all_pieces = board->bb_white_bishop | board->bb_white_king
         | board->bb_white_knight | board->bb_white_pawn | board->bb_white_queen
-        | board->bb_white_rook;
-    BitBoard all_pieces_black = board->bb_black_bishop | board->bb_black_king
+        | board->bb_white_rook | board->bb_black_bishop | board->bb_black_king
         | board->bb_black_knight | board->bb_black_pawn | board->bb_black_queen
         | board->bb_black_rook;
-    BitBoard all_pieces = all_pieces_black | all_pieces_white;
-    BitBoard my_pieces = white ? all_pieces_white : all_pieces_black;
-    BitBoard opp_diag_pieces = white ? black_diag_pieces : white_diag_pieces;
-    BitBoard opp_attackers = opp_diag_pieces;
-    BitBoard my_king = white ? board->bb_white_king : board->bb_black_king;
-    // check for horz/vert pins
+    BitBoard opp_attackers = OPP(bishop) | OPP(queen);
+    BitBoard my_king = MY(king);
+    // check for anti-diagonal pins
     BitBoard gen, last_my;
     get_pin(nw)
     get_pin(se)
@@ -1026,18 +1743,13 @@ static BitBoard get_pins_nwse(Board *board, bool white) {
 // Squares in [exclude] are overridden and considered empty.
 // If [exclude_pawn_moves], pawn forward advances are not included (effectively making this only return attacks).
 // Caller must free move array.
-static BitBoard *get_pseudo_legal_moves(Board *board, bool white, bool all_attacked, BitBoard exclude, bool exclude_pawn_moves) {
+static FORCE_INLINE BitBoard *get_pseudo_legal_moves(Board *board, const bool white, bool all_attacked, BitBoard exclude, bool exclude_pawn_moves) {
     BitBoard *dirmoves = (BitBoard*)malloc(16*sizeof(BitBoard));
-    if ((!all_attacked) && (exclude == 0) && (!exclude_pawn_moves)) {
-        if (white && board->bb_white_moves) {
-            memcpy(dirmoves, board->bb_white_moves, 16*sizeof(BitBoard));
-            return dirmoves;
-        } else if ((!white) && board->bb_black_moves) {
-            memcpy(dirmoves, board->bb_black_moves, 16*sizeof(BitBoard));
-            return dirmoves;
-        }
+    BitBoard **cache = white ? &board->bb_white_moves : &board->bb_black_moves;
+    if ((!all_attacked) && (exclude == 0) && (!exclude_pawn_moves) && *cache) {
+        memcpy(dirmoves, *cache, 16*sizeof(BitBoard));
+        return dirmoves;
     }
-    memset(dirmoves, 0, 16*sizeof(BitBoard));
     BitBoard all_pieces_white = board->bb_white_bishop | board->bb_white_king
         | board->bb_white_knight | board->bb_white_pawn | board->bb_white_queen
         | board->bb_white_rook;
@@ -1045,100 +1757,63 @@ static BitBoard *get_pseudo_legal_moves(Board *board, bool white, bool all_attac
         | board->bb_black_knight | board->bb_black_pawn | board->bb_black_queen
         | board->bb_black_rook;
     BitBoard all_pieces = all_pieces_black | all_pieces_white;
+    BitBoard opp_pieces = white ? all_pieces_black : all_pieces_white;
     BitBoard empty = exclude | ~all_pieces;
     BitBoard all_attacked_mask = all_attacked ? ~0ull : 0ull;
     BitBoard exclude_pawn_move_mask = exclude_pawn_moves ? 0ull : ~0ull;
-    if (white) {
-        BitBoard pawn_moves = bb_slide_n(board->bb_white_pawn) & empty & exclude_pawn_move_mask;
-        BitBoard pawn_big_moves = bb_slide_n(pawn_moves & 0x0000000000ff0000ull) & empty;
-        BitBoard pawn_attacks_ne = bb_slide_ne(board->bb_white_pawn) & (all_pieces_black | board->en_passant_target | all_attacked_mask);
-        BitBoard pawn_attacks_nw = bb_slide_nw(board->bb_white_pawn) & (all_pieces_black | board->en_passant_target | all_attacked_mask);
-        BitBoard ray_moves_n = bb_flood_n(board->bb_white_queen | board->bb_white_rook, empty, true);
-        BitBoard ray_moves_e = bb_flood_e(board->bb_white_queen | board->bb_white_rook, empty, true);
-        BitBoard ray_moves_s = bb_flood_s(board->bb_white_queen | board->bb_white_rook, empty, true);
-        BitBoard ray_moves_w = bb_flood_w(board->bb_white_queen | board->bb_white_rook, empty, true);
-        BitBoard ray_moves_ne = bb_flood_ne(board->bb_white_queen | board->bb_white_bishop, empty, true);
-        BitBoard ray_moves_nw = bb_flood_nw(board->bb_white_queen | board->bb_white_bishop, empty, true);
-        BitBoard ray_moves_se = bb_flood_se(board->bb_white_queen | board->bb_white_bishop, empty, true);
-        BitBoard ray_moves_sw = bb_flood_sw(board->bb_white_queen | board->bb_white_bishop, empty, true);
-        BitBoard king_moves_n = bb_slide_n(board->bb_white_king);
-        BitBoard king_moves_ne = bb_slide_ne(board->bb_white_king);
-        BitBoard king_moves_e = bb_slide_e(board->bb_white_king);
-        BitBoard king_moves_se = bb_slide_se(board->bb_white_king);
-        BitBoard king_moves_s = bb_slide_s(board->bb_white_king);
-        BitBoard king_moves_sw = bb_slide_sw(board->bb_white_king);
-        BitBoard king_moves_w = bb_slide_w(board->bb_white_king);
-        BitBoard king_moves_nw = bb_slide_nw(board->bb_white_king);
-        dirmoves[DIR_NNE] = bb_slide_n(bb_slide_n(bb_slide_e(board->bb_white_knight))) & (all_attacked_mask | ~all_pieces_white);
-        dirmoves[DIR_NEE] = bb_slide_n(bb_slide_e(bb_slide_e(board->bb_white_knight))) & (all_attacked_mask | ~all_pieces_white);
-        dirmoves[DIR_NNW] = bb_slide_n(bb_slide_n(bb_slide_w(board->bb_white_knight))) & (all_attacked_mask | ~all_pieces_white);
-        dirmoves[DIR_NWW] = bb_slide_n(bb_slide_w(bb_slide_w(board->bb_white_knight))) & (all_attacked_mask | ~all_pieces_white);
-        dirmoves[DIR_SSE] = bb_slide_s(bb_slide_s(bb_slide_e(board->bb_white_knight))) & (all_attacked_mask | ~all_pieces_white);
-        dirmoves[DIR_SEE] = bb_slide_s(bb_slide_e(bb_slide_e(board->bb_white_knight))) & (all_attacked_mask | ~all_pieces_white);
-        dirmoves[DIR_SSW] = bb_slide_s(bb_slide_s(bb_slide_w(board->bb_white_knight))) & (all_attacked_mask | ~all_pieces_white);
-        dirmoves[DIR_SWW] = bb_slide_s(bb_slide_w(bb_slide_w(board->bb_white_knight))) & (all_attacked_mask | ~all_pieces_white);
-        dirmoves[DIR_N] = (pawn_moves | pawn_big_moves | ray_moves_n | king_moves_n) & (all_attacked_mask | ~all_pieces_white);
-        dirmoves[DIR_NE] = (pawn_attacks_ne | ray_moves_ne | king_moves_ne) & (all_attacked_mask | ~all_pieces_white);
-        dirmoves[DIR_E] = (ray_moves_e | king_moves_e) & (all_attacked_mask | ~all_pieces_white);
-        dirmoves[DIR_SE] = (ray_moves_se | king_moves_se) & (all_attacked_mask | ~all_pieces_white);
-        dirmoves[DIR_S] = (ray_moves_s | king_moves_s) & (all_attacked_mask | ~all_pieces_white);
-        dirmoves[DIR_SW] = (ray_moves_sw | king_moves_sw) & (all_attacked_mask | ~all_pieces_white);
-        dirmoves[DIR_W] = (ray_moves_w | king_moves_w) & (all_attacked_mask | ~all_pieces_white);
-        dirmoves[DIR_NW] = (pawn_attacks_nw | ray_moves_nw | king_moves_nw) & (all_attacked_mask | ~all_pieces_white);
-    } else {
-        BitBoard pawn_moves = bb_slide_s(board->bb_black_pawn) & empty & exclude_pawn_move_mask;
-        BitBoard pawn_big_moves = bb_slide_s(pawn_moves & 0x0000ff0000000000ull) & empty;
-        BitBoard pawn_attacks_se = bb_slide_se(board->bb_black_pawn) & (all_pieces_white | board->en_passant_target | all_attacked_mask);
-        BitBoard pawn_attacks_sw = bb_slide_sw(board->bb_black_pawn) & (all_pieces_white | board->en_passant_target | all_attacked_mask);
-        BitBoard ray_moves_n = bb_flood_n(board->bb_black_queen | board->bb_black_rook, empty, true);
-        BitBoard ray_moves_e = bb_flood_e(board->bb_black_queen | board->bb_black_rook, empty, true);
-        BitBoard ray_moves_s = bb_flood_s(board->bb_black_queen | board->bb_black_rook, empty, true);
-        BitBoard ray_moves_w = bb_flood_w(board->bb_black_queen | board->bb_black_rook, empty, true);
-        BitBoard ray_moves_ne = bb_flood_ne(board->bb_black_queen | board->bb_black_bishop, empty, true);
-        BitBoard ray_moves_nw = bb_flood_nw(board->bb_black_queen | board->bb_black_bishop, empty, true);
-        BitBoard ray_moves_se = bb_flood_se(board->bb_black_queen | board->bb_black_bishop, empty, true);
-        BitBoard ray_moves_sw = bb_flood_sw(board->bb_black_queen | board->bb_black_bishop, empty, true);
-        BitBoard king_moves_n = bb_slide_n(board->bb_black_king);
-        BitBoard king_moves_ne = bb_slide_ne(board->bb_black_king);
-        BitBoard king_moves_e = bb_slide_e(board->bb_black_king);
-        BitBoard king_moves_se = bb_slide_se(board->bb_black_king);
-        BitBoard king_moves_s = bb_slide_s(board->bb_black_king);
-        BitBoard king_moves_sw = bb_slide_sw(board->bb_black_king);
-        BitBoard king_moves_w = bb_slide_w(board->bb_black_king);
-        BitBoard king_moves_nw = bb_slide_nw(board->bb_black_king);
-        dirmoves[DIR_NNE] = bb_slide_n(bb_slide_n(bb_slide_e(board->bb_black_knight))) & (all_attacked_mask | ~all_pieces_black);
-        dirmoves[DIR_NEE] = bb_slide_n(bb_slide_e(bb_slide_e(board->bb_black_knight))) & (all_attacked_mask | ~all_pieces_black);
-        dirmoves[DIR_NNW] = bb_slide_n(bb_slide_n(bb_slide_w(board->bb_black_knight))) & (all_attacked_mask | ~all_pieces_black);
-        dirmoves[DIR_NWW] = bb_slide_n(bb_slide_w(bb_slide_w(board->bb_black_knight))) & (all_attacked_mask | ~all_pieces_black);
-        dirmoves[DIR_SSE] = bb_slide_s(bb_slide_s(bb_slide_e(board->bb_black_knight))) & (all_attacked_mask | ~all_pieces_black);
-        dirmoves[DIR_SEE] = bb_slide_s(bb_slide_e(bb_slide_e(board->bb_black_knight))) & (all_attacked_mask | ~all_pieces_black);
-        dirmoves[DIR_SSW] = bb_slide_s(bb_slide_s(bb_slide_w(board->bb_black_knight))) & (all_attacked_mask | ~all_pieces_black);
-        dirmoves[DIR_SWW] = bb_slide_s(bb_slide_w(bb_slide_w(board->bb_black_knight))) & (all_attacked_mask | ~all_pieces_black);
-        dirmoves[DIR_N] = (ray_moves_n | king_moves_n) & (all_attacked_mask | ~all_pieces_black);
-        dirmoves[DIR_NE] = (ray_moves_ne | king_moves_ne) & (all_attacked_mask | ~all_pieces_black);
-        dirmoves[DIR_E] = (ray_moves_e | king_moves_e) & (all_attacked_mask | ~all_pieces_black);
-        dirmoves[DIR_SE] = (pawn_attacks_se | ray_moves_se | king_moves_se) & (all_attacked_mask | ~all_pieces_black);
-        dirmoves[DIR_S] = (pawn_moves | pawn_big_moves | ray_moves_s | king_moves_s) & (all_attacked_mask | ~all_pieces_black);
-        dirmoves[DIR_SW] = (pawn_attacks_sw | ray_moves_sw | king_moves_sw) & (all_attacked_mask | ~all_pieces_black);
-        dirmoves[DIR_W] = (ray_moves_w | king_moves_w) & (all_attacked_mask | ~all_pieces_black);
-        dirmoves[DIR_NW] = (ray_moves_nw | king_moves_nw) & (all_attacked_mask | ~all_pieces_black);
-    }
+    BitBoard targets = all_attacked_mask | ~(white ? all_pieces_white : all_pieces_black);
+    // white pawns advance north and attack NE/NW, black pawns advance south and attack SE/SW
+    BitBoard pawns = MY(pawn);
+    BitBoard pawn_moves = (white ? bb_slide_n(pawns) : bb_slide_s(pawns)) & empty & exclude_pawn_move_mask;
+    BitBoard pawn_big_moves = (white ? bb_slide_n(pawn_moves & 0x0000000000ff0000ull) : bb_slide_s(pawn_moves & 0x0000ff0000000000ull)) & empty;
+    BitBoard pawn_advances = pawn_moves | pawn_big_moves;
+    BitBoard pawn_attacks_e = (white ? bb_slide_ne(pawns) : bb_slide_se(pawns)) & (opp_pieces | board->en_passant_target | all_attacked_mask);
+    BitBoard pawn_attacks_w = (white ? bb_slide_nw(pawns) : bb_slide_sw(pawns)) & (opp_pieces | board->en_passant_target | all_attacked_mask);
+    BitBoard ray_moves_n = bb_flood_n(MY(queen) | MY(rook), empty, true);
+    BitBoard ray_moves_e = bb_flood_e(MY(queen) | MY(rook), empty, true);
+    BitBoard ray_moves_s = bb_flood_s(MY(queen) | MY(rook), empty, true);
+    BitBoard ray_moves_w = bb_flood_w(MY(queen) | MY(rook), empty, true);
+    BitBoard ray_moves_ne = bb_flood_ne(MY(queen) | MY(bishop), empty, true);
+    BitBoard ray_moves_nw = bb_flood_nw(MY(queen) | MY(bishop), empty, true);
+    BitBoard ray_moves_se = bb_flood_se(MY(queen) | MY(bishop), empty, true);
+    BitBoard ray_moves_sw = bb_flood_sw(MY(queen) | MY(bishop), empty, true);
+    BitBoard king = MY(king);
+    BitBoard king_moves_n = bb_slide_n(king);
+    BitBoard king_moves_ne = bb_slide_ne(king);
+    BitBoard king_moves_e = bb_slide_e(king);
+    BitBoard king_moves_se = bb_slide_se(king);
+    BitBoard king_moves_s = bb_slide_s(king);
+    BitBoard king_moves_sw = bb_slide_sw(king);
+    BitBoard king_moves_w = bb_slide_w(king);
+    BitBoard king_moves_nw = bb_slide_nw(king);
+    BitBoard knights = MY(knight);
+    dirmoves[DIR_NNE] = bb_slide_n(bb_slide_n(bb_slide_e(knights))) & targets;
+    dirmoves[DIR_NEE] = bb_slide_n(bb_slide_e(bb_slide_e(knights))) & targets;
+    dirmoves[DIR_NNW] = bb_slide_n(bb_slide_n(bb_slide_w(knights))) & targets;
+    dirmoves[DIR_NWW] = bb_slide_n(bb_slide_w(bb_slide_w(knights))) & targets;
+    dirmoves[DIR_SSE] = bb_slide_s(bb_slide_s(bb_slide_e(knights))) & targets;
+    dirmoves[DIR_SEE] = bb_slide_s(bb_slide_e(bb_slide_e(knights))) & targets;
+    dirmoves[DIR_SSW] = bb_slide_s(bb_slide_s(bb_slide_w(knights))) & targets;
+    dirmoves[DIR_SWW] = bb_slide_s(bb_slide_w(bb_slide_w(knights))) & targets;
+    dirmoves[DIR_N] = ((white ? pawn_advances : 0) | ray_moves_n | king_moves_n) & targets;
+    dirmoves[DIR_NE] = ((white ? pawn_attacks_e : 0) | ray_moves_ne | king_moves_ne) & targets;
+    dirmoves[DIR_E] = (ray_moves_e | king_moves_e) & targets;
+    dirmoves[DIR_SE] = ((white ? 0 : pawn_attacks_e) | ray_moves_se | king_moves_se) & targets;
+    dirmoves[DIR_S] = ((white ? 0 : pawn_advances) | ray_moves_s | king_moves_s) & targets;
+    dirmoves[DIR_SW] = ((white ? 0 : pawn_attacks_w) | ray_moves_sw | king_moves_sw) & targets;
+    dirmoves[DIR_W] = (ray_moves_w | king_moves_w) & targets;
+    dirmoves[DIR_NW] = ((white ? pawn_attacks_w : 0) | ray_moves_nw | king_moves_nw) & targets;
     if ((!all_attacked) && (exclude == 0) && (!exclude_pawn_moves)) {
-        if (white) {
-            board->bb_white_moves =(BitBoard*)malloc(16 * sizeof(BitBoard));
-            memcpy(board->bb_white_moves, dirmoves, 16 * sizeof(BitBoard));
-        } else {
-            board->bb_black_moves = (BitBoard*)malloc(16 * sizeof(BitBoard));
-            memcpy(board->bb_black_moves, dirmoves, 16 * sizeof(BitBoard));
-        }
+        *cache = (BitBoard*)malloc(16 * sizeof(BitBoard));
+        memcpy(*cache, dirmoves, 16 * sizeof(BitBoard));
     }
     return dirmoves;
 }
 
 // Returns true if the king is in check on [board]. Checks this for white if [white], otherwise checks for black.
-static bool in_check(Board *board, bool white) {
+static FORCE_INLINE bool in_check(Board *board, const bool white) {
     BitBoard *moves = get_pseudo_legal_moves(board, !white, true, 0, true);
-    BitBoard king_square = white ? board->bb_white_king : board->bb_black_king;
+    BitBoard king_square = MY(king);
     bool found = false;
     for (int dir = 0; dir < 16; dir++) {
         if ((moves[dir] & king_square) > 0) {
@@ -1150,8 +1825,13 @@ static bool in_check(Board *board, bool white) {
     return found;
 }
 
+// Returns true if the player to move on [board] is in check.
+static bool side_to_move_in_check(Board *board) {
+    return board->whiteToMove ? in_check(board, true) : in_check(board, false);
+}
+
 // Returns the number of pieces on [board] which attack [target]. Checks this for black attackers if [defenderWhite], otherwise checks for white attackers.
-static int num_attackers(Board *board, BitBoard target, bool defenderWhite) {
+static FORCE_INLINE int num_attackers(Board *board, BitBoard target, const bool defenderWhite) {
     BitBoard *moves = get_pseudo_legal_moves(board, !defenderWhite, true, 0, true);
     BitBoard king_square = defenderWhite ? board->bb_white_king : board->bb_black_king;
     int count = 0;
@@ -1163,7 +1843,7 @@ static int num_attackers(Board *board, BitBoard target, bool defenderWhite) {
 }
 
 // Returns valid positions from which an En Passant move can be performed on [board] by white if [white], otherwise by black
-static BitBoard en_passant_valid(Board *board, bool white) {
+static FORCE_INLINE BitBoard en_passant_valid(Board *board, const bool white) {
     BitBoard all_pieces_white = board->bb_white_bishop | board->bb_white_king
         | board->bb_white_knight | board->bb_white_pawn | board->bb_white_queen
         | board->bb_white_rook;
@@ -1171,7 +1851,7 @@ static BitBoard en_passant_valid(Board *board, bool white) {
         | board->bb_black_knight | board->bb_black_pawn | board->bb_black_queen
         | board->bb_black_rook;
     BitBoard all_pieces = all_pieces_black | all_pieces_white;
-    BitBoard king_square = white ? board->bb_white_king : board->bb_black_king;
+    BitBoard king_square = MY(king);
     BitBoard ept = board->en_passant_target;
     BitBoard valid = bb_slide_e(ept) | bb_slide_w(ept);
     bool one_ept_source = (valid & (valid - 1)) == 0;
@@ -1184,7 +1864,7 @@ static BitBoard en_passant_valid(Board *board, bool white) {
 
 // Returns squares on [board] which, if in single check, moving to would eliminate the check against white's king if [defenderWhite], black otherwise.
 // Only valid if single check situation
-static BitBoard single_check_block_tiles(Board *board, bool defenderWhite) {
+static FORCE_INLINE BitBoard single_check_block_tiles(Board *board, const bool defenderWhite) {
     BitBoard *moves = get_pseudo_legal_moves(board, !defenderWhite, true, 0, true);
     BitBoard all_pieces_white = board->bb_white_bishop | board->bb_white_king
         | board->bb_white_knight | board->bb_white_pawn | board->bb_white_queen
@@ -1233,13 +1913,13 @@ static Move *add_to_moves(Move *moves, size_t *len_moves, size_t *maxlen_moves,
     return moves;
 }
 
-// Returns the fully legal moves on [board].
+// Returns the fully legal moves on [board], which must have white to move if [white], otherwise black.
+// If [captures_only], only captures and promotions are returned, and other target squares are skipped.
 // Caller responsible for freeing array.
-static Move *get_legal_moves(Board *board, int *len) {
-    bool white = is_white_turn(board);
-    BitBoard my_king = white ? board->bb_white_king : board->bb_black_king;
-    BitBoard *pseudo_moves = get_pseudo_legal_moves(board, is_white_turn(board), false, 0, false);
-    BitBoard *opp_pseudo_moves = get_pseudo_legal_moves(board, !is_white_turn(board), true, my_king, true);
+static FORCE_INLINE Move *legal_moves(Board *board, int *len, const bool white, const bool captures_only) {
+    BitBoard my_king = MY(king);
+    BitBoard *pseudo_moves = get_pseudo_legal_moves(board, white, false, 0, false);
+    BitBoard *opp_pseudo_moves = get_pseudo_legal_moves(board, !white, true, my_king, true);
     /*char bitboard_dump[80];
     printf("DEBUG: directional attack boards follow\n");
     for (int i = 0; i < 16; i++) {
@@ -1248,7 +1928,7 @@ static Move *get_legal_moves(Board *board, int *len) {
     }*/
     // check situations
     bool check = in_check(board, white);
-    bool double_check = check && (num_attackers(board, white ? board->bb_white_king : board->bb_black_king, white) > 1);
+    bool double_check = check && (num_attackers(board, my_king, white) > 1);
     // get pinned pieces
     BitBoard pins_ns = get_pins_ns(board, white);
     BitBoard pins_ew = get_pins_ew(board, white);
@@ -1266,8 +1946,9 @@ static Move *get_legal_moves(Board *board, int *len) {
         | board->bb_black_rook;
     BitBoard empty = ~(all_pieces_black | all_pieces_white);
     BitBoard my_pieces = white ? all_pieces_white : all_pieces_black;
-    BitBoard my_pawns = white ? board->bb_white_pawn : board->bb_black_pawn;
+    BitBoard my_pawns = MY(pawn);
     BitBoard opp_pieces = white ? all_pieces_black : all_pieces_white;
+    BitBoard targets = captures_only ? (opp_pieces | board->en_passant_target | 0xff000000000000ffull) : ~0ull;
     // special considerations for checks
     BitBoard near_my_king = 0;
     BitBoard check_attacks = 0;
@@ -1303,6 +1984,10 @@ static Move *get_legal_moves(Board *board, int *len) {
             piecepos <<= 1;
             continue;
         }
+        if ((piecepos & targets) == 0) {
+            piecepos <<= 1;
+            continue;
+        }
         if (pseudo_moves[DIR_N] & piecepos) {
             add_move.from = bb_blocker_s(piecepos, ~my_pieces);
             //char movestr[8];
@@ -1697,6 +2382,14 @@ static Move *get_legal_moves(Board *board, int *len) {
         add_move.to = bb_slide_w(bb_slide_w(board->bb_black_king));
         moves = add_to_moves(moves, &len_moves, &maxlen_moves, add_move);
     }
+    if (captures_only) {
+        // the target squares also let through quiet moves to the back ranks or the en passant square, and castling
+        size_t kept = 0;
+        for (size_t i = 0; i < len_moves; i++) {
+            if (moves[i].capture || moves[i].promotion) moves[kept++] = moves[i];
+        }
+        len_moves = kept;
+    }
     // shrink array to fit
     moves = (Move*)realloc(moves, len_moves * sizeof(Move));
     *len = len_moves;
@@ -1705,22 +2398,143 @@ static Move *get_legal_moves(Board *board, int *len) {
     return moves;
 }
 
+// The color and captures-only specializations of legal_moves()
+static Move *gen_legal_white(Board *board, int *len) {
+    return legal_moves(board, len, true, false);
+}
+
+static Move *gen_legal_black(Board *board, int *len) {
+    return legal_moves(board, len, false, false);
+}
+
+static Move *gen_captures_white(Board *board, int *len) {
+    return legal_moves(board, len, true, true);
+}
+
+static Move *gen_captures_black(Board *board, int *len) {
+    return legal_moves(board, len, false, true);
+}
+
+// Returns the fully legal moves on [board].
+// Caller responsible for freeing array.
+static Move *get_legal_moves(Board *board, int *len) {
+    return board->whiteToMove ? gen_legal_white(board, len) : gen_legal_black(board, len);
+}
+
+// Returns the legal captures and promotions on [board].
+// Caller responsible for freeing array.
+static Move *get_legal_captures(Board *board, int *len) {
+    return board->whiteToMove ? gen_captures_white(board, len) : gen_captures_black(board, len);
+}
+
+// Batch analysis works on blocks of this many boards at a time. Within a block, every board's state is laid out
+// structure-of-arrays and each kernel is a branch-free loop over the lanes, so the compiler can vectorize it.
+#define BATCH_LANES 8
+
+typedef struct {
+    // [0] is the side to move, [1] its opponent
+    BitBoard pawns[2][BATCH_LANES];
+    BitBoard knights[2][BATCH_LANES];
+    BitBoard diagonal[2][BATCH_LANES];  // bishops and queens
+    BitBoard straight[2][BATCH_LANES];  // rooks and queens
+    BitBoard kings[2][BATCH_LANES];
+    BitBoard north[2][BATCH_LANES];     // all ones if that side's pawns move north, i.e. it is white
+    BitBoard occupied[BATCH_LANES];
+} BatchLanes;
+
+// Loads [count] boards (at most BATCH_LANES) into [lanes]. Unused lanes are left empty.
+static void batch_load(Board **boards, int count, BatchLanes *lanes) {
+    memset(lanes, 0, sizeof(BatchLanes));
+    for (int i = 0; i < count; i++) {
+        Board *board = boards[i];
+        for (int side = 0; side < 2; side++) {
+            const bool white = board->whiteToMove == (side == 0);
+            lanes->pawns[side][i] = MY(pawn);
+            lanes->knights[side][i] = MY(knight);
+            lanes->diagonal[side][i] = MY(bishop) | MY(queen);
+            lanes->straight[side][i] = MY(rook) | MY(queen);
+            lanes->kings[side][i] = MY(king);
+            lanes->north[side][i] = white ? ~0ull : 0ull;
+        }
+        lanes->occupied[i] = board->bb_white_pawn | board->bb_white_bishop | board->bb_white_knight
+            | board->bb_white_rook | board->bb_white_queen | board->bb_white_king
+            | board->bb_black_pawn | board->bb_black_bishop | board->bb_black_knight
+            | board->bb_black_rook | board->bb_black_queen | board->bb_black_king;
+    }
+}
+
+// Stores all squares attacked by [side] in each lane of [lanes] into [attacks]
+static void batch_attacks(const BatchLanes *lanes, int side, BitBoard *attacks) {
+    for (int i = 0; i < BATCH_LANES; i++) {
+        BitBoard empty = ~lanes->occupied[i];
+        BitBoard north = lanes->north[side][i];
+        BitBoard pawns = lanes->pawns[side][i];
+        BitBoard knights = lanes->knights[side][i];
+        BitBoard diagonal = lanes->diagonal[side][i];
+        BitBoard straight = lanes->straight[side][i];
+        BitBoard king = lanes->kings[side][i];
+        BitBoard pawn_attacks = ((bb_slide_ne(pawns) | bb_slide_nw(pawns)) & north)
+            | ((bb_slide_se(pawns) | bb_slide_sw(pawns)) & ~north);
+        BitBoard knight_attacks = bb_slide_n(bb_slide_n(bb_slide_e(knights))) | bb_slide_n(bb_slide_e(bb_slide_e(knights)))
+            | bb_slide_n(bb_slide_n(bb_slide_w(knights))) | bb_slide_n(bb_slide_w(bb_slide_w(knights)))
+            | bb_slide_s(bb_slide_s(bb_slide_e(knights))) | bb_slide_s(bb_slide_e(bb_slide_e(knights)))
+            | bb_slide_s(bb_slide_s(bb_slide_w(knights))) | bb_slide_s(bb_slide_w(bb_slide_w(knights)));
+        BitBoard king_row = king | bb_slide_e(king) | bb_slide_w(king);
+        BitBoard king_attacks = (king_row | bb_slide_n(king_row) | bb_slide_s(king_row)) ^ king;
+        BitBoard ray_attacks = bb_flood_n(straight, empty, true) | bb_flood_e(straight, empty, true)
+            | bb_flood_s(straight, empty, true) | bb_flood_w(straight, empty, true)
+            | bb_flood_ne(diagonal, empty, true) | bb_flood_nw(diagonal, empty, true)
+            | bb_flood_se(diagonal, empty, true) | bb_flood_sw(diagonal, empty, true);
+        attacks[i] = pawn_attacks | knight_attacks | king_attacks | ray_attacks;
+    }
+}
+
+// Analyzes [count] boards a block at a time, writing to each output array that is not NULL
+static void batch_analyze(Board **boards, int count, BitBoard *attacks, BitBoard *opp_attacks, bool *check, int *legal_moves) {
+    BatchLanes lanes;
+    BitBoard lane_attacks[BATCH_LANES];
+    BitBoard lane_opp_attacks[BATCH_LANES];
+    for (int base = 0; base < count; base += BATCH_LANES) {
+        int n = (count - base < BATCH_LANES) ? count - base : BATCH_LANES;
+        batch_load(boards + base, n, &lanes);
+        if (attacks) {
+            batch_attacks(&lanes, 0, lane_attacks);
+            memcpy(attacks + base, lane_attacks, n * sizeof(BitBoard));
+        }
+        if (opp_attacks || check) {
+            batch_attacks(&lanes, 1, lane_opp_attacks);
+            if (opp_attacks) memcpy(opp_attacks + base, lane_opp_attacks, n * sizeof(BitBoard));
+        }
+        if (check) {
+            for (int i = 0; i < n; i++) check[base + i] = (lane_opp_attacks[i] & lanes.kings[0][i]) != 0;
+        }
+    }
+    // legal move counts need the pin and check evasion logic, which doesn't batch, so they use the normal generator
+    if (legal_moves) {
+        for (int i = 0; i < count; i++) free(get_legal_moves(boards[i], &legal_moves[i]));
+    }
+}
+
 // Starts the Chess API internals, and returns the interface to the bot for access.
 static void start_chess_api() {
     API = (InternalAPI *)malloc(sizeof(InternalAPI));
     API->shared_board = NULL;
-    API->wtime = 0;
-    API->btime = 0;
-    memset(&API->latest_opponent_move, 0, sizeof(Move));
+    memset(&API->limits, 0, sizeof(SearchLimits));
+    API->search_move_count = 0;
+    atomic_init(&API->turn_started_millis, monotonic_millis());
+    atomic_init(&API->time_millis, 0);
+    atomic_init(&API->opponent_time_millis, 0);
+    atomic_init(&API->latest_opponent_move, 0);
+    atomic_init(&API->pondering, false);
+    memset(&API->latest_pushed_move, 0, sizeof(Move));
+    memset(&API->ponder_move, 0, sizeof(Move));
+    API->searching = false;
+    atomic_init(&API->stop_requested, false);
     //pthread_mutex_init(&API->mutex, NULL);
     //sem_init(&API->intermission_mutex, 0, 0);
     mtx_init(&API->mutex, mtx_plain);
     semaphore_init(&API->intermission_mutex, 0);
-    // setup zobrist keys
-    srand(time(NULL));
-    for (int i = 0; i < 781; i++) {
-        zobrist_keys[i] = rand_uint64_t();
-    }
+    init_zobrist_keys();
     // start the uci server in its own thread
     uci_start(&API->uci_thread);
     // block until uci endpoint says go
@@ -1729,7 +2543,6 @@ static void start_chess_api() {
 
 // Returns true if a threefold repetition has occurred on [board]
 static bool is_threefold_draw(Board *board) {
-    if (API == NULL) start_chess_api();
     // i hate everything
     int cur_size = 0;
     int max_size = 1;
@@ -1768,16 +2581,39 @@ static bool is_threefold_draw(Board *board) {
     return true;
 }
 
+// Returns whether neither player has the material left to checkmate on [board]:
+// bare kings, a single minor piece, or any number of bishops all on the same square color
+static bool is_insufficient_material(Board *board) {
+    if (board->bb_white_pawn | board->bb_black_pawn | board->bb_white_rook | board->bb_black_rook
+        | board->bb_white_queen | board->bb_black_queen) return false;
+    BitBoard knights = board->bb_white_knight | board->bb_black_knight;
+    BitBoard bishops = board->bb_white_bishop | board->bb_black_bishop;
+    BitBoard minors = knights | bishops;
+    if ((minors & (minors - 1)) == 0) return true;  // at most one minor piece
+    if (knights) return false;
+    const BitBoard light_squares = 0x55aa55aa55aa55aaull;
+    return (bishops & light_squares) == 0 || (bishops & ~light_squares) == 0;
+}
+
+// Returns whether [board] is drawn by a rule that needs no move generation: insufficient material or the 50-move rule
+static bool is_draw_fast(Board *board) {
+    return board->halfmoves >= 100 || is_insufficient_material(board);
+}
+
 // Returns GAME_NORMAL, GAME_STALEMATE or GAME_CHECKMATE based on the state on [board]
 static GameState get_board_end_state(Board *board) {
-    if (board->halfmoves >= 50) return GAME_STALEMATE;
+    if (is_insufficient_material(board)) return GAME_STALEMATE;
     if (is_threefold_draw(board)) return GAME_STALEMATE;
     int num_legal_moves;
     free(get_legal_moves(board, &num_legal_moves));
-    if (num_legal_moves > 0) return GAME_NORMAL;
-    bool check = in_check(board, board->whiteToMove);
-    if (check) return GAME_CHECKMATE;
-    return GAME_STALEMATE;
+    if (num_legal_moves == 0) {
+        bool check = side_to_move_in_check(board);
+        if (check) return GAME_CHECKMATE;
+        return GAME_STALEMATE;
+    }
+    // checked after move generation since checkmate on the 100th half move still wins
+    if (board->halfmoves >= 100) return GAME_STALEMATE;
+    return GAME_NORMAL;
 }
 
 Board *chess_get_board() {
@@ -1789,11 +2625,22 @@ Board *chess_clone_board(Board *board) {
     return clone_board(board);
 }
 
+Board *chess_clone_board_detached(Board *board) {
+    return clone_board_detached(board);
+}
+
 Move *chess_get_legal_moves(Board *board, int *len) {
-    if (API == NULL) start_chess_api();
     return get_legal_moves(board, len);
 }
 
+Move *chess_get_legal_captures(Board *board, int *len) {
+    return get_legal_captures(board, len);
+}
+
+void chess_batch_analyze(Board **boards, int count, BitBoard *attacks, BitBoard *opponent_attacks, bool *in_check, int *legal_move_counts) {
+    batch_analyze(boards, count, attacks, opponent_attacks, in_check, legal_move_counts);
+}
+
 bool chess_is_white_turn(Board *board) {
     return is_white_turn(board);
 }
@@ -1815,18 +2662,90 @@ uint64_t chess_zobrist_key(Board *board) {
     return board->hash;
 }
 
-void chess_make_move(Board *board, Move move) {
+int chess_get_psqt_score(Board *board) {
+    int phase = board->phase > PSQT_MAX_PHASE ? PSQT_MAX_PHASE : board->phase;
+    return (board->psqt_mg * phase + board->psqt_eg * (PSQT_MAX_PHASE - phase)) / PSQT_MAX_PHASE;
+}
+
+void chess_load_psqt(const int mg[6][64], const int eg[6][64]) {
+    load_psqt(mg, eg);
+}
+
+void chess_board_pack(Board *board, PackedBoard *packed) {
+    pack_board(board, packed);
+}
+
+Board *chess_board_unpack(const PackedBoard *packed) {
+    return unpack_board(packed);
+}
+
+Board *chess_board_from_fen(const char *fen) {
+    init_zobrist_keys();
+    Board *board = create_board();
+    set_board_from_fen(board, fen);
+    return board;
+}
+
+int chess_board_to_fen(Board *board, char *buffer) {
+    return board_to_fen(board, buffer);
+}
+
+size_t chess_write_packed_boards(FILE *file, const PackedBoard *packed, size_t count) {
+    return fwrite(packed, sizeof(PackedBoard), count, file);
+}
+
+size_t chess_read_packed_boards(FILE *file, PackedBoard *packed, size_t count) {
+    return fread(packed, sizeof(PackedBoard), count, file);
+}
+
+uint64_t chess_zobrist_key_after(Board *board, Move move) {
+    return zobrist_after(board, move);
+}
+
+void chess_add_spin_option(const char *name, int default_value, int min, int max) {
+    add_spin_option(name, default_value, min, max);
+}
+
+int chess_get_option(const char *name) {
+    if (API == NULL) start_chess_api();
+    return interface_get_option(name);
+}
+
+void chess_send_info(const SearchInfo *info) {
     if (API == NULL) start_chess_api();
+    interface_send_info(info);
+}
+
+void chess_send_info_string(const char *text) {
+    if (API == NULL) start_chess_api();
+    interface_send_info_string(text);
+}
+
+void chess_move_to_uci(Move move, char *buffer) {
+    dump_move(buffer, move);
+}
+
+void chess_set_prefetch_hook(void (*hook)(uint64_t key, void *context), void *context) {
+    prefetch_context = context;
+    prefetch_hook = hook;
+}
+
+void chess_set_bench_hook(void (*hook)(const char *args, void *context), void *context) {
+    bench_context = context;
+    bench_hook = hook;
+}
+
+void chess_make_move(Board *board, Move move) {
+    // let the bot start fetching the child's table entry while the board is being updated
+    if (prefetch_hook) prefetch_hook(zobrist_after(board, move), prefetch_context);
     make_move(board, move);
 }
 
 void chess_undo_move(Board *board) {
-    if (API == NULL) start_chess_api();
     undo_move(board);
 }
 
 void chess_free_board(Board *board) {
-    if (API == NULL) start_chess_api();
     free_board(board);
 }
 
@@ -1845,6 +2764,21 @@ uint64_t chess_get_elapsed_time_millis() {
     return interface_get_elapsed_time_millis();
 }
 
+uint64_t chess_get_increment_millis() {
+    if (API == NULL) start_chess_api();
+    return interface_get_increment_millis();
+}
+
+int chess_get_movestogo() {
+    if (API == NULL) start_chess_api();
+    return interface_get_movestogo();
+}
+
+uint64_t chess_get_movetime() {
+    if (API == NULL) start_chess_api();
+    return interface_get_movetime();
+}
+
 void chess_free_moves_array(Move *moves) {
     free(moves);
 }
@@ -1853,17 +2787,56 @@ int chess_get_half_moves(Board *board) {
     return board->halfmoves;
 }
 
+int chess_get_history_keys(Board *board, uint64_t *keys, int max) {
+    return history_keys(board, keys, max);
+}
+
 void chess_push(Move move)
 {
     if (API == NULL) start_chess_api();
     interface_push(move);
 }
 
+void chess_push_ponder(Move move) {
+    if (API == NULL) start_chess_api();
+    interface_push_ponder(move);
+}
+
 void chess_done() {
     if (API == NULL) start_chess_api();
     interface_done();
 }
 
+uint64_t chess_get_node_limit() {
+    if (API == NULL) start_chess_api();
+    return interface_get_node_limit();
+}
+
+int chess_get_depth_limit() {
+    if (API == NULL) start_chess_api();
+    return interface_get_depth_limit();
+}
+
+void chess_get_search_limits(SearchLimits *limits) {
+    if (API == NULL) start_chess_api();
+    interface_get_search_limits(limits);
+}
+
+int chess_get_search_moves(Move *moves, int max) {
+    if (API == NULL) start_chess_api();
+    return interface_get_search_moves(moves, max);
+}
+
+bool chess_is_pondering() {
+    if (API == NULL) start_chess_api();
+    return interface_is_pondering();
+}
+
+bool chess_should_stop() {
+    if (API == NULL) start_chess_api();
+    return interface_should_stop();
+}
+
 BitBoard chess_get_bitboard(Board *board, PlayerColor color, PieceType piece_type) {
     switch(piece_type) {
         case PAWN: return ((color == WHITE) ? board->bb_white_pawn : board->bb_black_pawn);
@@ -1876,12 +2849,42 @@ BitBoard chess_get_bitboard(Board *board, PlayerColor color, PieceType piece_typ
     return 0;  // bad piece_type
 }
 
+void chess_get_snapshot(Board *board, BoardSnapshot *snapshot) {
+    snapshot->pieces[WHITE][0] = board->bb_white_pawn | board->bb_white_bishop | board->bb_white_knight
+        | board->bb_white_rook | board->bb_white_queen | board->bb_white_king;
+    snapshot->pieces[WHITE][PAWN] = board->bb_white_pawn;
+    snapshot->pieces[WHITE][BISHOP] = board->bb_white_bishop;
+    snapshot->pieces[WHITE][KNIGHT] = board->bb_white_knight;
+    snapshot->pieces[WHITE][ROOK] = board->bb_white_rook;
+    snapshot->pieces[WHITE][QUEEN] = board->bb_white_queen;
+    snapshot->pieces[WHITE][KING] = board->bb_white_king;
+    snapshot->pieces[BLACK][0] = board->bb_black_pawn | board->bb_black_bishop | board->bb_black_knight
+        | board->bb_black_rook | board->bb_black_queen | board->bb_black_king;
+    snapshot->pieces[BLACK][PAWN] = board->bb_black_pawn;
+    snapshot->pieces[BLACK][BISHOP] = board->bb_black_bishop;
+    snapshot->pieces[BLACK][KNIGHT] = board->bb_black_knight;
+    snapshot->pieces[BLACK][ROOK] = board->bb_black_rook;
+    snapshot->pieces[BLACK][QUEEN] = board->bb_black_queen;
+    snapshot->pieces[BLACK][KING] = board->bb_black_king;
+    snapshot->occupied = snapshot->pieces[WHITE][0] | snapshot->pieces[BLACK][0];
+    snapshot->en_passant_target = board->en_passant_target;
+    snapshot->hash = board->hash;
+    snapshot->halfmoves = board->halfmoves;
+    snapshot->fullmoves = board->fullmoves;
+    snapshot->psqt_score = chess_get_psqt_score(board);
+    snapshot->white_to_move = board->whiteToMove;
+    snapshot->can_kingside_castle[WHITE] = board->can_castle_wk;
+    snapshot->can_kingside_castle[BLACK] = board->can_castle_bk;
+    snapshot->can_queenside_castle[WHITE] = board->can_castle_wq;
+    snapshot->can_queenside_castle[BLACK] = board->can_castle_bq;
+}
+
 int chess_get_full_moves(Board *board) {
     return board->fullmoves;
 }
 
 bool chess_is_check(Board *board) {
-    return in_check(board, board->whiteToMove);
+    return side_to_move_in_check(board);
 }
 
 void chess_skip_turn(Board *board) {
@@ -1891,23 +2894,22 @@ void chess_skip_turn(Board *board) {
 }
 
 bool chess_in_check(Board *board) {
-    return in_check(board, board->whiteToMove);
+    return side_to_move_in_check(board);
 }
 
 bool chess_in_checkmate(Board *board) {
     int num_legal_moves;
     free(get_legal_moves(board, &num_legal_moves));
     if (num_legal_moves > 0) return false;
-    return in_check(board, board->whiteToMove);
+    return side_to_move_in_check(board);
 }
 
 bool chess_in_draw(Board *board) {
-    if (board->halfmoves >= 50) return true;
-    if (is_threefold_draw(board)) return true;
-    int num_legal_moves;
-    free(get_legal_moves(board, &num_legal_moves));
-    if (num_legal_moves > 0) return false;
-    return !in_check(board, board->whiteToMove);
+    return get_board_end_state(board) == GAME_STALEMATE;
+}
+
+bool chess_is_draw_fast(Board *board) {
+    return is_draw_fast(board);
 }
 
 bool chess_can_kingside_castle(Board *board, PlayerColor color) {
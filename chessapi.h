@@ -5,6 +5,8 @@
 #pragma once
 
 #include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
 #include "bitboard.h"
 
 //! For Windows(MSVC) compatibility
@@ -51,6 +53,62 @@ typedef struct {
     bool castle;        /*!< True if this move is castling*/
 } Move;
 
+//! A BoardSnapshot is a plain copy of all the state of a board, for code that reads it many times
+typedef struct {
+    BitBoard pieces[2][7];           /*!< Piece BitBoards indexed by [PlayerColor][PieceType]; index 0 holds all pieces of that color*/
+    BitBoard occupied;               /*!< A BitBoard of all occupied squares*/
+    BitBoard en_passant_target;      /*!< A BitBoard of the en passant target square, or 0 if there is none*/
+    uint64_t hash;                   /*!< The Zobrist hash of the board*/
+    int halfmoves;                   /*!< The half move counter*/
+    int fullmoves;                   /*!< The full move counter*/
+    int psqt_score;                  /*!< The same score chess_get_psqt_score() returns*/
+    bool white_to_move;              /*!< True if it is white's turn*/
+    bool can_kingside_castle[2];     /*!< Kingside castling rights, indexed by PlayerColor*/
+    bool can_queenside_castle[2];    /*!< Queenside castling rights, indexed by PlayerColor*/
+} BoardSnapshot;
+
+//! A PackedBoard is a fixed-size, 32 byte binary encoding of a position, for storing large numbers of them
+typedef struct {
+    BitBoard occupancy;   /*!< A BitBoard of all occupied squares*/
+    uint8_t pieces[16];   /*!< One nibble per occupied square, in ascending square order, low nibble first: the PieceType, plus 8 for black*/
+    uint8_t flags;        /*!< Bit 0 is set if white is to move, bits 1-4 are the K, Q, k, q castling rights*/
+    uint8_t en_passant;   /*!< The index of the en passant target square, or 0xff if there is none*/
+    uint8_t halfmoves;    /*!< The half move counter, saturating at 255*/
+    uint8_t reserved;     /*!< Always zero*/
+    uint16_t fullmoves;   /*!< The full move counter*/
+    uint8_t padding[2];   /*!< Always zero*/
+} PackedBoard;
+
+//! SearchInfo holds the statistics of a search in progress, for chess_send_info() to report to the GUI
+typedef struct {
+    int depth;               /*!< The depth of the last completed iteration*/
+    int seldepth;            /*!< The greatest distance from the root reached, including extensions and captures*/
+    int multipv;             /*!< The 1-based number of the line reported, or 0 when there is only one line*/
+    int score;               /*!< The score in centipawns from the side to move's point of view, or moves to mate if mate is set*/
+    bool mate;               /*!< True if score counts moves to mate, negative if the side to move is getting mated*/
+    uint64_t nodes;          /*!< The number of positions searched*/
+    uint64_t time_millis;    /*!< The time spent searching, in milliseconds*/
+    int hashfull;            /*!< How full the hash table is, in permille, or -1 to leave it out*/
+    const Move *pv;          /*!< The principal variation, starting with the best move*/
+    int pv_length;           /*!< The number of moves in pv*/
+} SearchInfo;
+
+//! SearchLimits holds the limits the GUI set on the current search with "go"
+typedef struct {
+    uint64_t wtime;          /*!< White's remaining time in milliseconds, or 0 if not given*/
+    uint64_t btime;          /*!< Black's remaining time in milliseconds, or 0 if not given*/
+    uint64_t winc;           /*!< White's increment per move in milliseconds, or 0 if none*/
+    uint64_t binc;           /*!< Black's increment per move in milliseconds, or 0 if none*/
+    int movestogo;           /*!< The number of moves until the next time control, or 0 if the rest of the game must be played in the remaining time*/
+    uint64_t movetime;       /*!< The exact time to search in milliseconds, or 0 if not given*/
+    int depth;               /*!< The greatest depth to search in plies, or 0 for no limit*/
+    uint64_t nodes;          /*!< The greatest number of nodes to search, or 0 for no limit*/
+    int mate;                /*!< Search for a mate in this many moves, or 0 if not asked to*/
+    bool infinite;           /*!< True if the search must go on until "stop", even once it has nothing left to do*/
+    bool wtime_given;        /*!< True if the GUI sent White's clock, even if it has run out*/
+    bool btime_given;        /*!< True if the GUI sent Black's clock, even if it has run out*/
+} SearchLimits;
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -69,12 +127,28 @@ DLLEXPORT Board *chess_get_board();
 //! Returns a clone of the given board
 /*!
 The clone is not a deep clone, but uses reference counting to ensure reused shallow objects are not freed early
+The reference counts are not atomic, so clones of the same board must not be used from different threads
+\sa chess_clone_board_detached()
 Caller must free the board with free_board
 \sa chess_free_board()
 \return A clone of the given board
 */
 DLLEXPORT Board *chess_clone_board(Board *board);
 
+//! Returns an independent copy of the given board
+/*!
+Unlike chess_clone_board(), the copy shares no history with the original, so it is safe to hand to another thread.
+Only the history back to the last pawn move or capture is copied, which is all that repetition detection needs;
+undoing moves further back than that has no effect.
+Make detached clones before starting threads, as the original board must not change while it is being copied.
+Caller must free the board with free_board
+\sa chess_clone_board()
+\sa chess_free_board()
+\param board The board to copy
+\return An independent copy of the given board
+*/
+DLLEXPORT Board *chess_clone_board_detached(Board *board);
+
 //! Returns an array of legal moves
 /*!
 Caller must free array
@@ -84,6 +158,32 @@ Caller must free array
 */
 DLLEXPORT Move *chess_get_legal_moves(Board *board, int *len);
 
+//! Returns an array of the legal captures and promotions
+/*!
+This is the subset of chess_get_legal_moves() a quiescence search needs, and is cheaper to generate since quiet target squares are skipped.
+Caller must free array
+\sa chess_get_legal_moves()
+\param board The board to get legal captures on
+\param len A pointer in which the array length will be stored
+\return A pointer to the start of an array of moves
+*/
+DLLEXPORT Move *chess_get_legal_captures(Board *board, int *len);
+
+//! Analyzes many independent boards at once
+/*!
+Boards are processed in blocks whose state is laid out structure-of-arrays, so the attack and check computations
+are vectorized across boards instead of being made one call at a time.
+Each output array must hold count entries, and may be NULL if that result is not wanted.
+Legal move counts are computed with the normal move generator, so leave legal_move_counts NULL when they aren't needed.
+\param boards An array of boards to analyze
+\param count The number of boards
+\param attacks Receives the squares attacked by the player to move on each board
+\param opponent_attacks Receives the squares attacked by the other player on each board
+\param in_check Receives whether the player to move is in check on each board
+\param legal_move_counts Receives the number of legal moves on each board
+*/
+DLLEXPORT void chess_batch_analyze(Board **boards, int count, BitBoard *attacks, BitBoard *opponent_attacks, bool *in_check, int *legal_move_counts);
+
 //! Returns whether it is white's turn or not
 /*!
 \sa chess_is_black_turn()
@@ -125,12 +225,24 @@ DLLEXPORT bool chess_in_checkmate(Board *board);
 
 //! Returns whether the current player is in a draw
 /*!
-This function considers positions with no legal moves, the 50-move rule, and threefold repetition as draws.
+This function considers positions with no legal moves, insufficient material, the 50-move rule, and threefold repetition as draws.
+\sa chess_is_draw_fast()
 \param board The board to consider
 \return True if the current game is a draw for any reason
 */
 DLLEXPORT bool chess_in_draw(Board *board);
 
+//! Returns whether the board is a draw by a rule that can be checked without generating moves
+/*!
+This only considers insufficient material (bare kings, a single minor piece, or bishops all on one square color)
+and the 50-move rule (100 half moves without a capture or pawn move), so it is cheap enough to call at every node of a search.
+It does not check for stalemate or repetition, and does not rule out a checkmate delivered on the 100th half move.
+\sa chess_in_draw()
+\param board The board to consider
+\return True if the board is drawn by insufficient material or the 50-move rule
+*/
+DLLEXPORT bool chess_is_draw_fast(Board *board);
+
 
 //! Returns if the indicated player has kingside castling rights
 /*!
@@ -180,6 +292,47 @@ The hashes consider en passant and castling possibilities as part of the hash, t
 */
 DLLEXPORT uint64_t chess_zobrist_key(Board *board);
 
+//! Returns the Zobrist hash the board will have after a move, without making the move
+/*!
+This gives the same result as calling chess_zobrist_key() after chess_make_move(), but is much cheaper and leaves the board untouched.
+It is meant for prefetching transposition table entries before a move is made.
+\sa chess_set_prefetch_hook()
+\param board The board to consider
+\param move The move to consider, which must be legal on the board
+\return The hash associated with the board after the move
+*/
+DLLEXPORT uint64_t chess_zobrist_key_after(Board *board, Move move);
+
+//! Sets a function to be called with the resulting Zobrist hash at the start of every chess_make_move()
+/*!
+The hook runs before the board is updated, so a bot can use it to start prefetching its hash table entry for the new position.
+\sa chess_zobrist_key_after()
+\param hook The function to call, or NULL to remove the hook
+\param context A pointer passed through to the hook unchanged
+*/
+DLLEXPORT void chess_set_prefetch_hook(void (*hook)(uint64_t key, void *context), void *context);
+
+//! Returns the material and piece-square score of the board, from white's perspective.
+/*!
+The score is kept up to date incrementally by chess_make_move() and chess_undo_move(), so this is O(1).
+It is tapered between the middlegame and endgame tables by the amount of non-pawn material left on the board.
+\sa chess_load_psqt()
+\param board The board to consider
+\return The score in centipawns, positive if white is ahead
+*/
+DLLEXPORT int chess_get_psqt_score(Board *board);
+
+//! Replaces the piece-square tables used by chess_get_psqt_score().
+/*!
+Tables are indexed by [piece type - 1][square] and are given for white; black uses the same tables mirrored vertically.
+Each entry should include the material value of the piece as well as its positional bonus.
+Boards keep the scores they were created with, so load tables before calling chess_get_board().
+\sa chess_get_psqt_score()
+\param mg The middlegame table
+\param eg The endgame table
+*/
+DLLEXPORT void chess_load_psqt(const int mg[6][64], const int eg[6][64]);
+
 //! Performs a move on the board
 /*!
 \sa chess_undo_move()
@@ -214,6 +367,14 @@ For more info on working with BitBoards, see "bitboard.h"
 */
 DLLEXPORT BitBoard chess_get_bitboard(Board *board, PlayerColor color, PieceType piece_type);
 
+//! Copies all the state of the board into a snapshot in one call.
+/*!
+This is much cheaper than fetching the same information through chess_get_bitboard() and the other accessors one by one.
+\param board The board to consider
+\param snapshot The snapshot to fill
+*/
+DLLEXPORT void chess_get_snapshot(Board *board, BoardSnapshot *snapshot);
+
 //! Returns the full move counter for the board.
 /*
 This number starts at 1, and increments each time black moves.
@@ -232,6 +393,83 @@ This is mainly used for tracking progress to the 50-move draw rule.
 */
 DLLEXPORT int chess_get_half_moves(Board *board);
 
+//! Copies the Zobrist hashes of the positions that led to the board, back to the last pawn move or capture.
+/*!
+Earlier positions can never occur again, so these are all a bot needs to detect repetitions during its search.
+The hashes are written oldest first, and do not include the board itself.
+\sa chess_zobrist_key(), chess_get_half_moves()
+\param board The board to consider
+\param keys An array to write the hashes to
+\param max The length of [keys]; older positions beyond it are left out
+\return The number of hashes written
+*/
+DLLEXPORT int chess_get_history_keys(Board *board, uint64_t *keys, int max);
+
+
+///// SERIALIZATION /////
+
+
+//! Packs the given board into the fixed-size binary format.
+/*!
+The board history is not stored, so repetitions before the packed position are lost.
+\sa chess_board_unpack()
+\param board The board to pack
+\param packed The PackedBoard to write to
+*/
+DLLEXPORT void chess_board_pack(Board *board, PackedBoard *packed);
+
+//! Returns a new board from the binary format.
+/*!
+This does not require the chess server to be running, so it can be used by offline tools.
+Caller must free the board with free_board
+\sa chess_board_pack()
+\sa chess_free_board()
+\param packed The PackedBoard to read
+\return A new board with the packed position
+*/
+DLLEXPORT Board *chess_board_unpack(const PackedBoard *packed);
+
+//! Returns a new board with the position in a FEN string.
+/*!
+This does not require the chess server to be running, so it can be used by offline tools.
+The board has no history, so no earlier positions count towards repetitions.
+Caller must free the board with free_board
+\sa chess_board_to_fen()
+\sa chess_free_board()
+\param fen The FEN string, of which the half move and full move counters may be left out
+\return A new board with the position
+*/
+DLLEXPORT Board *chess_board_from_fen(const char *fen);
+
+//! Writes the FEN string of the given board.
+/*!
+\param board The board to consider
+\param buffer The buffer to write to, which should be at least 92 bytes
+\return The length of the FEN string, not including the terminating null character
+*/
+DLLEXPORT int chess_board_to_fen(Board *board, char *buffer);
+
+//! Writes packed boards to a binary file.
+/*!
+Packed boards are written in host byte order, so files are only portable between machines of the same endianness.
+\sa chess_read_packed_boards()
+\param file The file to write to, opened in binary mode
+\param packed A pointer to the start of an array of packed boards
+\param count The number of packed boards to write
+\return The number of packed boards written
+*/
+DLLEXPORT size_t chess_write_packed_boards(FILE *file, const PackedBoard *packed, size_t count);
+
+//! Reads packed boards from a binary file.
+/*!
+\sa chess_write_packed_boards()
+\param file The file to read from, opened in binary mode
+\param packed A pointer to the start of an array to read into
+\param count The maximum number of packed boards to read
+\return The number of packed boards read, which is less than count at the end of the file
+*/
+DLLEXPORT size_t chess_read_packed_boards(FILE *file, PackedBoard *packed, size_t count);
+
 
 ///// MOVE SUBMISSION /////
 
@@ -240,11 +478,21 @@ DLLEXPORT int chess_get_half_moves(Board *board);
 /*!
 You can call this more than once per turn.
 The latest move pushed by the bot will be played by the server once chess_done() is called.
+Every search starts with no move pushed; a bot that has no legal move can push a zeroed Move, or nothing, to answer with the null move "0000".
 \sa chess_done()
 \param move The move to submit
 */
 DLLEXPORT void chess_push(Move move);
 
+//! Submit the reply the bot expects from the opponent to the move it pushed.
+/*!
+The GUI may then ask the bot to ponder, searching the position after this reply during the opponent's time.
+Pushing a new move with chess_push() clears the ponder move, so push it after the final move.
+\sa chess_is_pondering()
+\param move The expected reply, which must be legal after the latest pushed move
+*/
+DLLEXPORT void chess_push_ponder(Move move);
+
 //! Ends the current turn.
 /*!
 The latest move pushed will be played by the server.
@@ -253,6 +501,24 @@ This method will block until the opponent's turn has passed.
 */
 DLLEXPORT void chess_done();
 
+//! Returns true while the bot is searching on the opponent's time.
+/*!
+A ponder search is for the position after the move given to chess_push_ponder(), before the opponent has actually played it.
+It should ignore the clock until this returns false: either the GUI sent "ponderhit", and the search carries on as a normal one
+with chess_get_elapsed_time_millis() counting from that moment, or it sent "stop", and chess_should_stop() returns true.
+The bot must not call chess_done() while this returns true.
+\return True if the current search is a ponder search
+*/
+DLLEXPORT bool chess_is_pondering();
+
+//! Returns true once the GUI has asked the bot to stop searching.
+/*!
+The bot should push its best move so far and call chess_done() as soon as it can.
+The flag is read without locking, so this is cheap enough to call every few hundred nodes.
+\return True if the GUI sent "stop" since the current search began
+*/
+DLLEXPORT bool chess_should_stop();
+
 
 ///// TIME MANAGEMENT /////
 
@@ -270,14 +536,123 @@ DLLEXPORT uint64_t chess_get_time_millis();
 */
 DLLEXPORT uint64_t chess_get_opponent_time_millis();
 
+//! Returns the time this bot gains after each of its moves, in ms.
+/*!
+\return Increment, in milliseconds, or 0 if there is none.
+*/
+DLLEXPORT uint64_t chess_get_increment_millis();
+
+//! Returns the number of moves to play before the clock is topped up.
+/*!
+\return Moves until the next time control, or 0 if the remaining time must last the rest of the game.
+*/
+DLLEXPORT int chess_get_movestogo();
+
+//! Returns the exact time the GUI asked this search to take with "go movetime", in ms.
+/*!
+A search with a move time should use all of it, and ignore the remaining time on the clock.
+\return Time to search, in milliseconds, or 0 if not given.
+*/
+DLLEXPORT uint64_t chess_get_movetime();
+
 //! Returns how much time has elapsed this turn, in ms.
 /*!
+This is wall clock time, so it stays right when the bot searches on several threads, and it is read without locking,
+so a search can poll it every few thousand nodes at no real cost.
 \sa chess_get_time_millis()
 \return Elapsed time, in milliseconds.
 */
 DLLEXPORT uint64_t chess_get_elapsed_time_millis();
 
 
+///// SEARCH LIMITS /////
+
+
+//! Returns the number of nodes the GUI limited this search to with "go nodes".
+/*!
+A node limited search should ignore the clock. Searching exactly this many nodes on one thread, with the hash table and any
+other tables cleared first, gives the same result on every run, which makes it useful for comparing builds.
+\return The node limit, or 0 if there is none
+*/
+DLLEXPORT uint64_t chess_get_node_limit();
+
+//! Returns the depth the GUI limited this search to with "go depth".
+/*!
+A depth limited search should ignore the clock.
+\return The depth limit in plies, or 0 if there is none
+*/
+DLLEXPORT int chess_get_depth_limit();
+
+//! Copies all the limits the GUI set on this search.
+/*!
+\sa chess_get_search_moves()
+\param limits The SearchLimits to write to
+*/
+DLLEXPORT void chess_get_search_limits(SearchLimits *limits);
+
+//! Writes the moves the GUI restricted this search to with "go searchmoves".
+/*!
+The moves are as the GUI sent them, and should be matched against the legal moves by their squares and promotion.
+\param moves The buffer to write to
+\param max The size of the buffer
+\return The number of moves written, or 0 if the search may consider every legal move
+*/
+DLLEXPORT int chess_get_search_moves(Move *moves, int max);
+
+
+///// OPTIONS /////
+
+
+//! Declares an integer option for the GUI to set.
+/*!
+Options must be declared before the first call that starts the chess server, such as chess_get_board(), so they can be listed in the reply to "uci".
+The GUI then sets them with "setoption name <name> value <x>"; values outside the range are clamped into it.
+\sa chess_get_option()
+\param name The option name, as shown in the GUI. Names are case insensitive and at most 63 characters
+\param default_value The value until the GUI sets it
+\param min The smallest value allowed
+\param max The largest value allowed
+*/
+DLLEXPORT void chess_add_spin_option(const char *name, int default_value, int min, int max);
+
+//! Returns the current value of an option.
+/*!
+\sa chess_add_spin_option()
+\param name The option name, in any case
+\return The value the GUI set, the default if it set none, or 0 if the option was never declared
+*/
+DLLEXPORT int chess_get_option(const char *name);
+
+
+///// SEARCH INFO /////
+
+
+//! Reports the progress of a search to the GUI as a UCI info line.
+/*!
+The nodes per second figure is worked out from the nodes and time. Each call writes one line, so a search should call
+this once per iteration, or less often, rather than once per node.
+\param info The statistics to report
+*/
+DLLEXPORT void chess_send_info(const SearchInfo *info);
+
+//! Sends free text to the GUI as an "info string" line, for debugging output.
+/*!
+\param text The text to send, which must not contain line breaks
+*/
+DLLEXPORT void chess_send_info_string(const char *text);
+
+//! Sets a function to be called when the GUI sends "bench", for running a benchmark from the UCI console.
+/*!
+The hook runs on the thread that reads UCI commands, so no other command is handled until it returns.
+It is only called between searches, so it may reuse the bot's search state; during a search the command is refused.
+It should search boards of its own, made with chess_board_from_fen(), and report through chess_send_info_string().
+Like options, it must be set before the first call that starts the chess server.
+\param hook The function to call with the rest of the "bench" line, or NULL to remove the hook
+\param context A pointer passed through to the hook unchanged
+*/
+DLLEXPORT void chess_set_bench_hook(void (*hook)(const char *args, void *context), void *context);
+
+
 ///// BITBOARDS /////
 
 
@@ -353,6 +728,14 @@ If no moves have been made yet, the returned move will have all its fields set t
 */
 DLLEXPORT Move chess_get_opponent_move();
 
+//! Writes a move in the long algebraic notation UCI uses, such as "e2e4" or "e7e8q".
+/*!
+A zeroed Move is written as the null move, "0000".
+\param move The move to write
+\param buffer A buffer of at least 7 characters to write the null terminated string to
+*/
+DLLEXPORT void chess_move_to_uci(Move move, char *buffer);
+
 //! Free function for an array of moves.
 /*!
 This is intended for move arrays such as the one returned from get_legal_moves.